@@ -33,6 +33,9 @@ void ChromePlus() {
   // Enhancement of the address bar, tab, and bookmark.
   TabBookmark();
 
+  // Apply chrome++.ini edits while running.
+  WatchConfig();
+
   // Patch the pak file.
   PakPatch();
 
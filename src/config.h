@@ -1,46 +1,224 @@
 #ifndef CONFIG_H_
 #define CONFIG_H_
 
-std::wstring GetCrCommandLine() {
-  auto commandLine = GetIniString(L"general", L"command_line", L"");
-  if (!commandLine.empty()) {
-    return commandLine;
+#include <atomic>
+#include <thread>
+
+// How a bookmark or an address bar URL opens in a new tab.
+enum NewTabOpen {
+  kNewTabDisabled,
+  kNewTabForeground,
+  kNewTabBackground,
+};
+
+// The settings of chrome++.ini, parsed once per change of the file. The
+// mouse and keyboard hooks read them from here instead of going to the file
+// on every event.
+struct Config {
+  // [general]
+  std::wstring command_line;
+  std::wstring launch_on_startup;
+  std::wstring launch_on_exit;
+  bool kill_launch_on_exit = false;
+  // As written, empty for the default directory; see GetDirPath.
+  std::wstring data_dir;
+  std::wstring cache_dir;
+  std::wstring boss_key;
+  std::wstring translate_key;
+  // View password without verification.
+  bool show_password = true;
+  // Force enable win32k.
+  bool win32k = false;
+
+  // [tabs]
+  bool keep_last_tab = true;
+  bool double_click_close = true;
+  bool right_click_close = false;
+  bool wheel_tab = true;
+  bool wheel_tab_when_press_rbutton = true;
+  NewTabOpen open_url_new_tab = kNewTabDisabled;
+  NewTabOpen open_bookmark_new_tab = kNewTabDisabled;
+  bool new_tab_disable = true;
+  // Customize disabled tab page name.
+  std::wstring new_tab_disable_name;
+};
+
+// The [general] value of |key|, or of the deprecated |old_key| when it is
+// empty.
+std::wstring GetConfigString(const IniFile& ini,
+                             const char* key,
+                             const char* old_key) {
+  std::string value = ini.Get("general", key);
+  if (value.empty())
+    value = ini.Get("general", old_key);
+  return Utf8ToWide(value);
+}
+
+// The data_dir or cache_dir value, empty when unset. The deprecated datadir
+// or cachedir is only read when the new key is set but empty.
+std::wstring GetConfigDir(const IniFile& ini, const std::string& type) {
+  const std::string* value = ini.Find("general", type + "_dir");
+  if (value && value->empty())
+    value = ini.Find("general", type + "dir");  // Deprecated
+  return value ? Utf8ToWide(*value) : L"";
+}
+
+NewTabOpen GetConfigNewTabOpen(const IniFile& ini, const char* key) {
+  switch (ini.GetInt("tabs", key, 0)) {
+    case 1:
+      return kNewTabForeground;
+    case 2:
+      return kNewTabBackground;
+    default:
+      return kNewTabDisabled;
   }
-  return GetIniString(L"General", L"CommandLine", L"");  // Deprecated
-}
-std::wstring GetLaunchOnStartup() {
-  return GetIniString(L"general", L"launch_on_startup", L"");
-}
-
-bool IsKillLaunchOnExit() {
-  return ::GetPrivateProfileIntW(L"general", L"kill_launch_on_exit", 0,
-                                 kIniPath.c_str()) != 0;
 }
 
-std::wstring GetLaunchOnExit() {
-  return GetIniString(L"general", L"launch_on_exit", L"");
+void ReadConfig(const IniFile& ini, Config& config) {
+  config.command_line = GetConfigString(ini, "command_line", "CommandLine");
+  config.launch_on_startup =
+      Utf8ToWide(ini.Get("general", "launch_on_startup"));
+  config.launch_on_exit = Utf8ToWide(ini.Get("general", "launch_on_exit"));
+  config.kill_launch_on_exit =
+      ini.GetInt("general", "kill_launch_on_exit", 0) != 0;
+  config.data_dir = GetConfigDir(ini, "data");
+  config.cache_dir = GetConfigDir(ini, "cache");
+  config.boss_key = GetConfigString(ini, "boss_key", "Bosskey");
+  config.translate_key =
+      GetConfigString(ini, "translate_key", "TranslateKey");
+  config.show_password = ini.GetInt("general", "show_password", 1) != 0;
+  config.win32k = ini.GetInt("general", "win32k", 0) != 0;
+
+  config.keep_last_tab = ini.GetInt("tabs", "keep_last_tab", 1) != 0;
+  config.double_click_close = ini.GetInt("tabs", "double_click_close", 1) != 0;
+  config.right_click_close = ini.GetInt("tabs", "right_click_close", 0) != 0;
+  config.wheel_tab = ini.GetInt("tabs", "wheel_tab", 1) != 0;
+  config.wheel_tab_when_press_rbutton =
+      ini.GetInt("tabs", "wheel_tab_when_press_rbutton", 1) != 0;
+  config.open_url_new_tab = GetConfigNewTabOpen(ini, "open_url_new_tab");
+  config.open_bookmark_new_tab =
+      GetConfigNewTabOpen(ini, "open_bookmark_new_tab");
+  config.new_tab_disable = ini.GetInt("tabs", "new_tab_disable", 1) != 0;
+  config.new_tab_disable_name =
+      Utf8ToWide(ini.Get("tabs", "new_tab_disable_name"));
+}
+
+const Config* LoadConfig() {
+  IniFile ini;
+  LoadIniFile(kIniPath, ini);
+  Config* config = new Config;
+  ReadConfig(ini, *config);
+  return config;
+}
+
+// The current snapshot of chrome++.ini. A reload publishes a new snapshot
+// with one pointer swap, readers never lock. Replaced snapshots are never
+// freed, a hook may still be reading one; edits are rare and a Config is
+// small.
+std::atomic<const Config*> config_snapshot{nullptr};
+
+// chrome++.ini as of the last reload. Keep the reference for one event at
+// most so that edits apply to the next one.
+const Config& GetConfig() {
+  const Config* config = config_snapshot.load(std::memory_order_acquire);
+  if (!config) {
+    // First use, racing threads agree on one snapshot.
+    const Config* loaded = LoadConfig();
+    if (config_snapshot.compare_exchange_strong(config, loaded,
+                                                std::memory_order_acq_rel)) {
+      config = loaded;
+    } else {
+      delete loaded;
+    }
+  }
+  return *config;
+}
+
+FILETIME GetConfigWriteTime() {
+  WIN32_FILE_ATTRIBUTE_DATA data = {0};
+  if (!GetFileAttributesExW(kIniPath.c_str(), GetFileExInfoStandard, &data))
+    return FILETIME{0, 0};
+  return data.ftLastWriteTime;
+}
+
+// Wait until whoever writes chrome++.ini is done: the file opens without
+// sharing writes, and its size and write time hold still between two looks
+// 50 ms apart. Return at once when the file is gone, and give up after
+// about two seconds.
+void WaitForConfigWritten() {
+  BY_HANDLE_FILE_INFORMATION last = {0};
+  bool have_last = false;
+  for (int attempt = 0; attempt < 40; ++attempt) {
+    HANDLE file = CreateFileW(kIniPath.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      DWORD error = GetLastError();
+      if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+        return;
+      have_last = false;
+    } else {
+      BY_HANDLE_FILE_INFORMATION info;
+      bool got = GetFileInformationByHandle(file, &info);
+      CloseHandle(file);
+      if (got && have_last && info.nFileSizeHigh == last.nFileSizeHigh &&
+          info.nFileSizeLow == last.nFileSizeLow &&
+          CompareFileTime(&info.ftLastWriteTime, &last.ftLastWriteTime) == 0)
+        return;
+      last = info;
+      have_last = got;
+    }
+    Sleep(50);
+  }
+  DebugLog(L"%s is still being written", kIniPath.c_str());
+}
+
+// Reload chrome++.ini in the background whenever it is written, so that the
+// settings the hooks read apply without a restart. A deleted file reloads
+// the defaults.
+void WatchConfig() {
+  GetConfig();
+  std::thread([]() {
+    HANDLE change = FindFirstChangeNotificationW(
+        GetAppDir().c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (change == INVALID_HANDLE_VALUE) {
+      DebugLog(L"WatchConfig failed %d", GetLastError());
+      return;
+    }
+
+    FILETIME last_write = GetConfigWriteTime();
+    while (WaitForSingleObject(change, INFINITE) == WAIT_OBJECT_0) {
+      // Re-arm first, a write that lands after the read signals again. The
+      // other files of the directory leave the write time alone.
+      FindNextChangeNotification(change);
+      FILETIME write = GetConfigWriteTime();
+      if (CompareFileTime(&write, &last_write) == 0)
+        continue;
+      WaitForConfigWritten();
+      last_write = GetConfigWriteTime();
+      config_snapshot.store(LoadConfig(), std::memory_order_release);
+      DebugLog(L"Reloaded %s", kIniPath.c_str());
+    }
+    FindCloseChangeNotification(change);
+  }).detach();
 }
 
 std::wstring GetDirPath(const std::wstring& dir_type) {
-  std::wstring path = CanonicalizePath(GetAppDir() + L"\\..\\" + dir_type);
-  std::wstring dir_key = dir_type + L"_dir";
-  std::wstring dir_buffer = GetIniString(L"general", dir_key, path);
+  const Config& config = GetConfig();
+  std::wstring dir_buffer =
+      dir_type == L"data" ? config.data_dir : config.cache_dir;
 
   if (dir_buffer == L"none") {
     return L"";
   }
 
-  if (dir_buffer.empty()) {  // Deprecated
-    dir_key = dir_type + L"dir";
-    dir_buffer = GetIniString(L"general", dir_key, path);
-  }
-
   if (dir_buffer.empty()) {
-    dir_buffer = path;
+    dir_buffer = CanonicalizePath(GetAppDir() + L"\\..\\" + dir_type);
   }
 
   std::wstring expanded_path = ExpandEnvironmentPath(dir_buffer);
-  ReplaceStringInPlace(expanded_path, L"%app%", GetAppDir());
+  ReplaceAll(expanded_path, {{L"%app%", GetAppDir()}});
   std::wstring dir = GetAbsolutePath(expanded_path);
   return dir;
 }
@@ -53,93 +231,4 @@ std::wstring GetDiskCacheDir() {
   return GetDirPath(L"cache");
 }
 
-std::wstring GetBosskey() {
-  auto key = GetIniString(L"general", L"boss_key", L"");
-  if (!key.empty()) {
-    return key;
-  }
-  return GetIniString(L"General", L"Bosskey", L"");  // Deprecated
-}
-
-std::wstring GetTranslateKey() {
-  auto key = GetIniString(L"general", L"translate_key", L"");
-  if (!key.empty()) {
-    return key;
-  }
-  return GetIniString(L"General", L"TranslateKey", L"");  // Deprecated
-}
-
-// View password without verification
-bool IsShowPassword() {
-  return ::GetPrivateProfileIntW(L"general", L"show_password", 1,
-                                 kIniPath.c_str()) != 0;
-}
-
-// Force enable win32k
-bool IsWin32K() {
-  return ::GetPrivateProfileIntW(L"general", L"win32k", 0, kIniPath.c_str()) !=
-         0;
-}
-
-bool IsKeepLastTab() {
-  return ::GetPrivateProfileIntW(L"tabs", L"keep_last_tab", 1,
-                                 kIniPath.c_str()) != 0;
-}
-
-bool IsDoubleClickClose() {
-  return ::GetPrivateProfileIntW(L"tabs", L"double_click_close", 1,
-                                 kIniPath.c_str()) != 0;
-}
-
-bool IsRightClickClose() {
-  return ::GetPrivateProfileIntW(L"tabs", L"right_click_close", 0,
-                                 kIniPath.c_str()) != 0;
-}
-
-bool IsWheelTab() {
-  return ::GetPrivateProfileIntW(L"tabs", L"wheel_tab", 1, kIniPath.c_str()) !=
-         0;
-}
-
-bool IsWheelTabWhenPressRightButton() {
-  return ::GetPrivateProfileIntW(L"tabs", L"wheel_tab_when_press_rbutton", 1,
-                                 kIniPath.c_str()) != 0;
-}
-
-std::string IsOpenUrlNewTabFun() {
-  int value = ::GetPrivateProfileIntW(L"tabs", L"open_url_new_tab", 0,
-                                      kIniPath.c_str());
-  switch (value) {
-    case 1:
-      return "foreground";
-    case 2:
-      return "background";
-    default:
-      return "disabled";
-  }
-}
-
-std::string IsBookmarkNewTab() {
-  int value = ::GetPrivateProfileIntW(L"tabs", L"open_bookmark_new_tab", 0,
-                                      kIniPath.c_str());
-  switch (value) {
-    case 1:
-      return "foreground";
-    case 2:
-      return "background";
-    default:
-      return "disabled";
-  }
-}
-
-bool IsNewTabDisable() {
-  return ::GetPrivateProfileIntW(L"tabs", L"new_tab_disable", 1,
-                                 kIniPath.c_str()) != 0;
-}
-
-// Customize disabled tab page name
-std::wstring GetDisableTabName() {
-  return GetIniString(L"tabs", L"new_tab_disable_name", L"");
-}
-
 #endif  // CONFIG_H_
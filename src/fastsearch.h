@@ -2,6 +2,28 @@
 #define FASTSEARCH_H_
 
 #include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define FASTSEARCH_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions that ask for
+// them, MSVC accepts the intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define FASTSEARCH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FASTSEARCH_TARGET_AVX2
+#endif
 
 static const uint8_t* ForceSearch(const uint8_t* s, int n, const uint8_t* p) {
   int i;
@@ -14,21 +36,157 @@ static const uint8_t* ForceSearch(const uint8_t* s, int n, const uint8_t* p) {
   return nullptr;
 }
 
-static const uint8_t* SundaySearch(const uint8_t* s,
+// Crochemore-Perrin critical factorization of the needle. Return the split
+// position and store the period of the right half in |period|.
+static int CriticalFactorization(const uint8_t* p, int m, int* period) {
+  if (m < 3) {
+    *period = 1;
+    return m - 1;
+  }
+
+  // Maximal suffix for the byte order, then for the reversed order.
+  int max_suffix = -1;
+  int j = 0, k = 1, q = 1;
+  while (j + k < m) {
+    uint8_t a = p[j + k];
+    uint8_t b = p[max_suffix + k];
+    if (a < b) {
+      j += k;
+      k = 1;
+      q = j - max_suffix;
+    } else if (a == b) {
+      if (k != q) {
+        ++k;
+      } else {
+        j += q;
+        k = 1;
+      }
+    } else {
+      max_suffix = j++;
+      k = q = 1;
+    }
+  }
+  *period = q;
+
+  int max_suffix_rev = -1;
+  j = 0;
+  k = q = 1;
+  while (j + k < m) {
+    uint8_t a = p[j + k];
+    uint8_t b = p[max_suffix_rev + k];
+    if (b < a) {
+      j += k;
+      k = 1;
+      q = j - max_suffix_rev;
+    } else if (a == b) {
+      if (k != q) {
+        ++k;
+      } else {
+        j += q;
+        k = 1;
+      }
+    } else {
+      max_suffix_rev = j++;
+      k = q = 1;
+    }
+  }
+
+  if (max_suffix_rev < max_suffix) {
+    return max_suffix + 1;
+  }
+  *period = q;
+  return max_suffix_rev + 1;
+}
+
+// Two-Way string matching: O(n + m) time and O(1) extra space whatever the
+// input, at the price of a slower constant than Sunday on ordinary text.
+static const uint8_t* TwoWaySearch(const uint8_t* s,
                                    int n,
                                    const uint8_t* p,
                                    int m) {
-  int i, j;
+  int period;
+  int suffix = CriticalFactorization(p, m, &period);
+
+  if (memcmp(p, p + period, suffix) == 0) {
+    // Periodic needle, remember how much of the left half already matched.
+    int memory = 0;
+    int j = 0;
+    while (j <= n - m) {
+      int i = (std::max)(suffix, memory);
+      while (i < m && p[i] == s[i + j]) {
+        ++i;
+      }
+      if (i >= m) {
+        i = suffix - 1;
+        while (i >= memory && p[i] == s[i + j]) {
+          --i;
+        }
+        if (i < memory) {
+          return s + j;
+        }
+        j += period;
+        memory = m - period;
+      } else {
+        j += i - suffix + 1;
+        memory = 0;
+      }
+    }
+  } else {
+    period = (std::max)(suffix, m - suffix) + 1;
+    int j = 0;
+    while (j <= n - m) {
+      int i = suffix;
+      while (i < m && p[i] == s[i + j]) {
+        ++i;
+      }
+      if (i >= m) {
+        i = suffix - 1;
+        while (i >= 0 && p[i] == s[i + j]) {
+          --i;
+        }
+        if (i < 0) {
+          return s + j;
+        }
+        j += period;
+      } else {
+        j += i - suffix + 1;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+// Sunday and the SIMD filters are O(n * m) on repetitive input such as runs
+// of zero bytes. They count the bytes they compare and hand the rest of the
+// buffer over to `TwoWaySearch` once that exceeds this many per byte
+// scanned, so the worst case stays linear.
+const int kSearchBudgetFactor = 4;
+const int kSearchBudgetSlack = 4096;
 
-  size_t skip[256];
+static bool OverSearchBudget(int64_t compared, int scanned) {
+  return compared > (int64_t)kSearchBudgetFactor * scanned + kSearchBudgetSlack;
+}
 
-  for (i = 0; i < 256; ++i) {
+// Sunday's bad character table, indexed by the byte right after the window:
+// how far the window may move.
+constexpr void SundayBuildSkip(const uint8_t* p, int m, uint32_t* skip) {
+  for (int i = 0; i < 256; ++i) {
     skip[i] = m + 1;
   }
 
-  for (i = 0; i < m; ++i) {
+  for (int i = 0; i < m; ++i) {
     skip[p[i]] = m - i;
   }
+}
+
+static const uint8_t* SundayScan(const uint8_t* s,
+                                 int n,
+                                 const uint8_t* p,
+                                 int m,
+                                 const uint32_t* skip) {
+  int i, j;
+  int64_t compared = 0;
 
   i = 0;
   while (i <= n - m) {
@@ -40,23 +198,277 @@ static const uint8_t* SundaySearch(const uint8_t* s,
       }
     }
 
+    compared += j + 1;
+    if (OverSearchBudget(compared, i + m)) {
+      return TwoWaySearch(s + i, n - i, p, m);
+    }
+
+    if (i + m >= n) {
+      break;
+    }
     i += (int)skip[s[i + m]];
   }
 
   return nullptr;
 }
 
+static const uint8_t* SundaySearch(const uint8_t* s,
+                                   int n,
+                                   const uint8_t* p,
+                                   int m) {
+  uint32_t skip[256];
+  SundayBuildSkip(p, m, skip);
+  return SundayScan(s, n, p, m, skip);
+}
+
+// The scalar path, used on non-x86 builds and for the tail the vector
+// kernels cannot cover.
+static const uint8_t* ScalarSearch(const uint8_t* s,
+                                   int n,
+                                   const uint8_t* p,
+                                   int m) {
+  if (m == 1) {
+    return ForceSearch(s, n, p);
+  }
+  return SundaySearch(s, n, p, m);
+}
+
+#ifdef FASTSEARCH_X86
+static int LowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Compare the first and the last byte of the needle against 16 candidate
+// positions at once, and only verify the middle of the candidates that pass.
+// Candidates are visited from low to high, so the result is the leftmost
+// match, the same one `SundaySearch` finds.
+static const uint8_t* Sse2Search(const uint8_t* s,
+                                 int n,
+                                 const uint8_t* p,
+                                 int m) {
+  const __m128i first = _mm_set1_epi8((char)p[0]);
+  const __m128i last = _mm_set1_epi8((char)p[m - 1]);
+
+  int64_t compared = 0;
+  int i = 0;
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    const __m128i block_first = _mm_loadu_si128((const __m128i*)(s + i));
+    const __m128i block_last =
+        _mm_loadu_si128((const __m128i*)(s + i + m - 1));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                      _mm_cmpeq_epi8(last, block_last)));
+    while (mask) {
+      int bit = LowestBit(mask);
+      if (m <= 2 || memcmp(s + i + bit + 1, p + 1, m - 2) == 0) {
+        return s + i + bit;
+      }
+      mask &= mask - 1;
+      compared += m;
+    }
+
+    if (OverSearchBudget(compared, i + m)) {
+      return TwoWaySearch(s + i, n - i, p, m);
+    }
+  }
+
+  if (n - i < m) {
+    return nullptr;
+  }
+  return ScalarSearch(s + i, n - i, p, m);
+}
+
+// Same as `Sse2Search` with 32 candidate positions per step.
+FASTSEARCH_TARGET_AVX2
+static const uint8_t* Avx2Search(const uint8_t* s,
+                                 int n,
+                                 const uint8_t* p,
+                                 int m) {
+  const __m256i first = _mm256_set1_epi8((char)p[0]);
+  const __m256i last = _mm256_set1_epi8((char)p[m - 1]);
+
+  int64_t compared = 0;
+  int i = 0;
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    const __m256i block_first = _mm256_loadu_si256((const __m256i*)(s + i));
+    const __m256i block_last =
+        _mm256_loadu_si256((const __m256i*)(s + i + m - 1));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                         _mm256_cmpeq_epi8(last, block_last)));
+    while (mask) {
+      int bit = LowestBit(mask);
+      if (m <= 2 || memcmp(s + i + bit + 1, p + 1, m - 2) == 0) {
+        return s + i + bit;
+      }
+      mask &= mask - 1;
+      compared += m;
+    }
+
+    if (OverSearchBudget(compared, i + m)) {
+      return TwoWaySearch(s + i, n - i, p, m);
+    }
+  }
+
+  if (n - i < m) {
+    return nullptr;
+  }
+  return Sse2Search(s + i, n - i, p, m);
+}
+
+static bool IsAvx2Supported() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // The OS must save the YMM registers on context switch.
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif  // FASTSEARCH_X86
+
+typedef const uint8_t* (*SearchKernel)(const uint8_t* s,
+                                       int n,
+                                       const uint8_t* p,
+                                       int m);
+
+// Pick the widest kernel the CPU supports, CPUID is only queried once.
+static SearchKernel GetSearchKernel() {
+  static const SearchKernel kernel = []() -> SearchKernel {
+#ifdef FASTSEARCH_X86
+    if (IsAvx2Supported()) {
+      return Avx2Search;
+    }
+    // SSE2 is part of the x64 baseline and required by every Windows version
+    // Chrome still runs on.
+    return Sse2Search;
+#else
+    return ScalarSearch;
+#endif
+  }();
+  return kernel;
+}
+
 const uint8_t* FastSearch(const uint8_t* s, int n, const uint8_t* p, int m) {
   if (!s || !p || n < m)
     return nullptr;
 
   if (m == 0) {
     return s;
-  } else if (m == 1) {
-    return ForceSearch(s, n, p);
   }
 
-  return SundaySearch(s, n, p, m);
+  return GetSearchKernel()(s, n, p, m);
 }
 
+// A needle with its Sunday skip table computed once, for callers that search
+// the same literal many times. Literals can be compiled at compile time:
+//
+//   constexpr Searcher kNeedle("</settings-about-page>");
+//
+// The searcher keeps a pointer to the pattern, which must outlive it.
+class Searcher {
+ public:
+  template <size_t N>
+  constexpr Searcher(const char (&literal)[N])
+      : pattern_(literal), length_((int)N - 1) {
+    // SundayBuildSkip works on bytes, a literal is still char here.
+    for (int i = 0; i < 256; ++i) {
+      skip_[i] = length_ + 1;
+    }
+    for (int i = 0; i < length_; ++i) {
+      skip_[(uint8_t)literal[i]] = length_ - i;
+    }
+  }
+
+  Searcher(const uint8_t* pattern, int length)
+      : pattern_((const char*)pattern), length_(length) {
+    SundayBuildSkip(pattern, length, skip_);
+  }
+
+  const uint8_t* pattern() const { return (const uint8_t*)pattern_; }
+  int size() const { return length_; }
+
+  const uint8_t* Search(const uint8_t* s, int n) const {
+    if (!s || n < length_)
+      return nullptr;
+    if (length_ == 0)
+      return s;
+    return SundayScan(s, n, pattern(), length_, skip_);
+  }
+
+  uint8_t* Search(uint8_t* s, int n) const {
+    return (uint8_t*)Search((const uint8_t*)s, n);
+  }
+
+  // Iterate over the non-overlapping matches, the search resumes right after
+  // the previous match instead of starting over:
+  //
+  //   for (const uint8_t* match : searcher.FindAll(buffer, size)) { ... }
+  class Iterator {
+   public:
+    Iterator(const Searcher* searcher, const uint8_t* end, const uint8_t* pos)
+        : searcher_(searcher), end_(end), match_(pos) {}
+
+    const uint8_t* operator*() const { return match_; }
+
+    Iterator& operator++() {
+      const uint8_t* next = match_ + (std::max)(searcher_->size(), 1);
+      match_ = next <= end_ ? searcher_->Search(next, (int)(end_ - next))
+                            : nullptr;
+      return *this;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return match_ != other.match_;
+    }
+
+   private:
+    const Searcher* searcher_;
+    const uint8_t* end_;
+    const uint8_t* match_;
+  };
+
+  class Range {
+   public:
+    Range(const Searcher* searcher, const uint8_t* s, int n)
+        : searcher_(searcher), s_(s), n_(n) {}
+
+    Iterator begin() const {
+      return Iterator(searcher_, s_ + n_, searcher_->Search(s_, n_));
+    }
+    Iterator end() const { return Iterator(searcher_, s_ + n_, nullptr); }
+
+   private:
+    const Searcher* searcher_;
+    const uint8_t* s_;
+    int n_;
+  };
+
+  Range FindAll(const uint8_t* s, int n) const { return Range(this, s, n); }
+
+ private:
+  const char* pattern_;
+  int length_;
+  uint32_t skip_[256] = {};
+};
+
 #endif  // FASTSEARCH_H_
@@ -0,0 +1,21 @@
+#ifndef FUNCTIONKEY_H_
+#define FUNCTIONKEY_H_
+
+#include <string_view>
+
+// The number of a function key name like L"F5" or L"f12", 1 to 24, or 0.
+// Only the digits right after the 'F' are read, |key| need not be null
+// terminated.
+int ParseFunctionKey(std::wstring_view key) {
+  if (key.size() < 2 || (key[0] != L'F' && key[0] != L'f'))
+    return 0;
+  int number = 0;
+  for (size_t i = 1; i < key.size() && key[i] >= L'0' && key[i] <= L'9' &&
+                     number <= 24;
+       ++i) {
+    number = number * 10 + (key[i] - L'0');
+  }
+  return number >= 1 && number <= 24 ? number : 0;
+}
+
+#endif  // FUNCTIONKEY_H_
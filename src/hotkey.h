@@ -3,13 +3,12 @@
 
 #include <iterator>
 
+#include "functionkey.h"
+
 UINT ParseHotkeys(const wchar_t* keys) {
   UINT mo = 0;
   UINT vk = 0;
 
-  std::wstring temp = keys;
-  std::vector<std::wstring> key_parts = StringSplit(temp, L'+', L"");
-
   std::unordered_map<std::wstring, UINT> keyMap = {
       {L"shift", MOD_SHIFT},  {L"ctrl", MOD_CONTROL}, {L"alt", MOD_ALT},
       {L"win", MOD_WIN},      {L"left", VK_LEFT},     {L"right", VK_RIGHT},
@@ -22,7 +21,9 @@ UINT ParseHotkeys(const wchar_t* keys) {
       {L"pageup", VK_PRIOR},  {L"pagedown", VK_NEXT},
   };
 
-  for (auto& key : key_parts) {
+  for (std::wstring_view key : StringSplit(keys, L'+')) {
+    if (key.empty())
+      continue;
     std::wstring lowerKey;
     std::transform(key.begin(), key.end(), std::back_inserter(lowerKey),
                    ::tolower);
@@ -42,13 +43,9 @@ UINT ParseHotkeys(const wchar_t* keys) {
           vk = toupper(wch);
         else
           vk = LOWORD(VkKeyScan(wch));
-      } else if (wch == 'F' || wch == 'f')  // Parse the F1-F24 function keys.
+      } else if (int FX = ParseFunctionKey(key))  // F1-F24.
       {
-        if (isdigit(key[1])) {
-          int FX = _wtoi(&key[1]);
-          if (FX >= 1 && FX <= 24)
-            vk = VK_F1 + FX - 1;
-        }
+        vk = VK_F1 + FX - 1;
       }
     }
   }
@@ -130,12 +127,13 @@ void Hotkey(const std::wstring& keys, HotkeyAction action) {
 }
 
 void GetHotkey() {
-  std::wstring bossKey = GetBosskey();
+  const Config& config = GetConfig();
+  const std::wstring& bossKey = config.boss_key;
   if (!bossKey.empty()) {
     Hotkey(bossKey, HideAndShow);
   }
 
-  std::wstring translateKey = GetTranslateKey();
+  const std::wstring& translateKey = config.translate_key;
   if (!translateKey.empty()) {
     Hotkey(translateKey, Translate);
   }
@@ -0,0 +1,232 @@
+#ifndef HTMLMINIFY_H_
+#define HTMLMINIFY_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fastsearch.h"
+
+// Whitespace minification of patched resources. Everything works in place
+// with one read and one write cursor and allocates nothing. Text between
+// whitespace is found 16 bytes at a time and moved in one piece.
+enum MinifyMode {
+  kMinifyNone,
+  // Trim the whitespace around every line and keep every newline.
+  kMinifyLines,
+  // Collapse every whitespace run into one newline if it had one, or one
+  // space otherwise, so line based syntax like ASI keeps working.
+  kMinifyCollapse,
+  // Collapse like kMinifyCollapse, but only in HTML text and between
+  // attributes. Quoted attribute values and the contents of <pre>,
+  // <script>, <style> and <textarea> are left untouched. CSS that makes
+  // other elements keep their whitespace is not detected.
+  kMinifyHtml,
+};
+
+static bool IsMinifySpace(uint8_t c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool IsMinifyMarkup(uint8_t c) {
+  return c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+// Offset of the first byte at or after |i| that minifying may change, or
+// |size|: whitespace other than a lone space between two other bytes, which
+// every mode keeps as it is, and markup too when |markup| is set.
+static size_t FindMinifyStop(const uint8_t* data,
+                             size_t i,
+                             size_t size,
+                             bool markup) {
+#ifdef FASTSEARCH_X86
+  // ' ' or a byte in '\t'..'\r', which is (c - '\t') <= 4 unsigned.
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i apostrophe = _mm_set1_epi8('\'');
+  auto whitespace = [&](__m128i block) {
+    __m128i control = _mm_sub_epi8(block, tab);
+    return _mm_or_si128(_mm_cmpeq_epi8(block, space),
+                        _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+  };
+  for (; i + 17 <= size; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i next = _mm_loadu_si128((const __m128i*)(data + i + 1));
+    __m128i spaces = _mm_cmpeq_epi8(block, space);
+    __m128i found =
+        _mm_or_si128(_mm_andnot_si128(spaces, whitespace(block)),
+                     _mm_and_si128(spaces, whitespace(next)));
+    if (markup) {
+      found = _mm_or_si128(
+          found, _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, lt),
+                                           _mm_cmpeq_epi8(block, gt)),
+                              _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                                           _mm_cmpeq_epi8(block, apostrophe))));
+    }
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(found);
+    if (mask)
+      return i + LowestBit(mask);
+  }
+#endif
+  for (; i < size; ++i) {
+    uint8_t c = data[i];
+    if (markup && IsMinifyMarkup(c))
+      break;
+    if (IsMinifySpace(c) &&
+        (c != ' ' || i + 1 == size || IsMinifySpace(data[i + 1])))
+      break;
+  }
+  return i;
+}
+
+// Elements whose contents kMinifyHtml copies as they are.
+static bool IsRawHtmlElement(const uint8_t* name, size_t length) {
+  static const char* const kRaw[] = {"pre", "script", "style", "textarea"};
+  for (const char* raw : kRaw) {
+    if (length != strlen(raw))
+      continue;
+    size_t k = 0;
+    while (k < length && (name[k] | 0x20) == raw[k]) {
+      ++k;
+    }
+    if (k == length)
+      return true;
+  }
+  return false;
+}
+
+// Offset of the "</name" that closes a raw element, or |size|.
+static size_t FindRawHtmlEnd(const uint8_t* data,
+                             size_t i,
+                             size_t size,
+                             const uint8_t* name,
+                             size_t length) {
+  for (; i + 2 + length <= size; ++i) {
+    if (data[i] != '<' || data[i + 1] != '/')
+      continue;
+    size_t k = 0;
+    while (k < length && (data[i + 2 + k] | 0x20) == (name[k] | 0x20)) {
+      ++k;
+    }
+    if (k == length)
+      return i;
+  }
+  return size;
+}
+
+// Minify [data, data + size) in place and return the new size.
+uint32_t MinifyWhitespace(uint8_t* data, uint32_t size, MinifyMode mode) {
+  if (mode == kMinifyNone)
+    return size;
+
+  const bool html = mode == kMinifyHtml;
+  size_t out = 0;
+  size_t i = 0;
+  auto copy = [&](size_t end) {
+    memmove(data + out, data + i, end - i);
+    out += end - i;
+    i = end;
+  };
+
+  // Inside a tag, and the quote of the attribute value being read.
+  bool in_tag = false;
+  uint8_t in_quote = 0;
+  const uint8_t* tag_name = nullptr;
+  size_t tag_length = 0;
+  bool raw_tag = false;
+
+  while (i < size) {
+    // A lone space is only dropped when it leads the first line.
+    if (i > 0 || !IsMinifySpace(data[0]))
+      copy(FindMinifyStop(data, i, size, html));
+    if (i == size)
+      break;
+
+    uint8_t c = data[i];
+    if (!IsMinifySpace(c)) {
+      // Markup, only looked at in kMinifyHtml.
+      if (in_quote) {
+        if (c == in_quote)
+          in_quote = 0;
+        copy(i + 1);
+      } else if (in_tag) {
+        if (c == '"' || c == '\'') {
+          in_quote = c;
+          copy(i + 1);
+        } else if (c == '>') {
+          in_tag = false;
+          copy(i + 1);
+          if (raw_tag)
+            copy(FindRawHtmlEnd(data, i, size, tag_name, tag_length));
+        } else {
+          copy(i + 1);
+        }
+      } else if (c == '<' && size - i >= 4 && !memcmp(data + i, "<!--", 4)) {
+        // Comments may hold quotes and tags, copy them as they are.
+        size_t end = i + 4;
+        while (end + 3 <= size && memcmp(data + end, "-->", 3) != 0) {
+          ++end;
+        }
+        copy(end + 3 <= size ? end + 3 : size);
+      } else if (c == '<') {
+        // A start or end tag, anything else is text.
+        size_t name = i + 1;
+        bool end_tag = name < size && data[name] == '/';
+        name += end_tag;
+        size_t name_end = name;
+        while (name_end < size &&
+               (((data[name_end] | 0x20) >= 'a' &&
+                 (data[name_end] | 0x20) <= 'z') ||
+                (data[name_end] >= '0' && data[name_end] <= '9') ||
+                data[name_end] == '-')) {
+          ++name_end;
+        }
+        in_tag = name_end > name || (name < size && data[name] == '!');
+        // The name is read from the output, where it moves with the tag.
+        raw_tag = in_tag && !end_tag &&
+                  IsRawHtmlElement(data + name, name_end - name);
+        tag_name = data + out + (name - i);
+        tag_length = name_end - name;
+        copy(name_end);
+      } else {
+        copy(i + 1);
+      }
+      continue;
+    }
+
+    if (in_quote) {
+      copy(i + 1);
+      continue;
+    }
+
+    // A whitespace run.
+    size_t run = i;
+    size_t newlines = 0;
+    while (run < size && IsMinifySpace(data[run])) {
+      newlines += data[run] == '\n';
+      ++run;
+    }
+
+    if (mode == kMinifyLines) {
+      if (newlines) {
+        memset(data + out, '\n', newlines);
+        out += newlines;
+        i = run;
+      } else if (i == 0 || run == size) {
+        // Leading whitespace of the first line, trailing of the last.
+        i = run;
+      } else {
+        copy(run);
+      }
+    } else {
+      data[out++] = newlines ? '\n' : ' ';
+      i = run;
+    }
+  }
+  return (uint32_t)out;
+}
+
+#endif  // HTMLMINIFY_H_
@@ -311,7 +311,7 @@ bool IsOnOneTab(NodePtr top, POINT pt) {
 }
 
 bool IsOnlyOneTab(NodePtr top) {
-  if (!IsKeepLastTab()) {
+  if (!GetConfig().keep_last_tab) {
     return false;
   }
   auto tab_count = GetTabCount(top);
@@ -358,8 +358,7 @@ bool IsNameNewTab(NodePtr top) {
     return false;
   }
 
-  std::vector<std::wstring> disable_tab_names =
-      StringSplit(GetDisableTabName(), L',', L"\"");
+  const std::wstring& disable_tab_names = GetConfig().new_tab_disable_name;
   TraversalAccessible(
       page_tab_pane, [&flag, &new_tab_name, &disable_tab_names](NodePtr child) {
         if (GetAccessibleState(child) & STATE_SYSTEM_SELECTED) {
@@ -368,7 +367,8 @@ bool IsNameNewTab(NodePtr top) {
                 std::wstring_view bstr_view(bstr);
                 std::wstring_view new_tab_view(new_tab_name.get());
                 flag = (bstr_view.find(new_tab_view) != std::wstring::npos);
-                for (const auto& tab_name : disable_tab_names) {
+                for (std::wstring_view tab_name :
+                     StringSplit(disable_tab_names, L',', L"\"")) {
                   if (bstr_view.find(tab_name) != std::wstring::npos) {
                     flag = true;
                     break;
@@ -384,7 +384,7 @@ bool IsNameNewTab(NodePtr top) {
 // Determine whether it is a new tab page from the document value of the tab
 // page.
 bool IsDocNewTab() {
-  auto cr_command_line = GetCrCommandLine();
+  const std::wstring& cr_command_line = GetConfig().command_line;
   if (cr_command_line.find(L"--force-renderer-accessibility") ==
       std::wstring::npos) {
     return false;
@@ -415,7 +415,7 @@ bool IsDocNewTab() {
 }
 
 bool IsOnNewTab(NodePtr top) {
-  if (!IsNewTabDisable()) {
+  if (!GetConfig().new_tab_disable) {
     return false;
   }
   return IsNameNewTab(top) || IsDocNewTab();
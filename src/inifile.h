@@ -0,0 +1,212 @@
+#ifndef INIFILE_H_
+#define INIFILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// chrome++.ini is UTF-16LE, a .pakrules file may be UTF-8 as well. Return
+// the text as UTF-8.
+std::string DecodeIniText(std::string_view raw) {
+  if (raw.size() < 2 || (uint8_t)raw[0] != 0xFF || (uint8_t)raw[1] != 0xFE) {
+    if (raw.substr(0, 3) == "\xEF\xBB\xBF")
+      raw.remove_prefix(3);
+    return std::string(raw);
+  }
+
+  std::string text;
+  text.reserve(raw.size() / 2);
+  for (size_t i = 2; i + 1 < raw.size(); i += 2) {
+    uint32_t c = (uint8_t)raw[i] | (uint8_t)raw[i + 1] << 8;
+    if (c >= 0xD800 && c < 0xDC00 && i + 3 < raw.size()) {
+      uint32_t low = (uint8_t)raw[i + 2] | (uint8_t)raw[i + 3] << 8;
+      if (low >= 0xDC00 && low < 0xE000) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+    }
+    if (c < 0x80) {
+      text += (char)c;
+    } else if (c < 0x800) {
+      text += (char)(0xC0 | c >> 6);
+      text += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      text += (char)(0xE0 | c >> 12);
+      text += (char)(0x80 | (c >> 6 & 0x3F));
+      text += (char)(0x80 | (c & 0x3F));
+    } else {
+      text += (char)(0xF0 | c >> 18);
+      text += (char)(0x80 | (c >> 12 & 0x3F));
+      text += (char)(0x80 | (c >> 6 & 0x3F));
+      text += (char)(0x80 | (c & 0x3F));
+    }
+  }
+  return text;
+}
+
+// UTF-8 to UTF-16 where wchar_t is 16 bits wide and to UTF-32 elsewhere.
+// Invalid bytes are kept as they are.
+std::wstring Utf8ToWide(std::string_view text) {
+  std::wstring wide;
+  wide.reserve(text.size());
+  for (size_t i = 0; i < text.size();) {
+    uint32_t c = (uint8_t)text[i];
+    size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    if (length > 1 && i + length <= text.size()) {
+      c &= 0x3F >> (length - 1);
+      for (size_t k = 1; k < length; ++k) {
+        c = c << 6 | ((uint8_t)text[i + k] & 0x3F);
+      }
+    } else {
+      length = 1;
+    }
+    i += length;
+    if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+      wide += (wchar_t)(0xD800 + ((c - 0x10000) >> 10));
+      wide += (wchar_t)(0xDC00 + ((c - 0x10000) & 0x3FF));
+    } else {
+      wide += (wchar_t)c;
+    }
+  }
+  return wide;
+}
+
+bool IsIniNameEqual(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + ('a' - 'A') : a[i];
+    char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + ('a' - 'A') : b[i];
+    if (x != y)
+      return false;
+  }
+  return true;
+}
+
+// An INI file read the way GetPrivateProfileString reads it: names are
+// matched without regard to ASCII case, the first section and key of a name
+// win, whitespace around names and values is trimmed, one pair of quotes
+// around a value is dropped, and lines starting with ';' are comments. The
+// whole file is parsed once, lookups do not touch the filesystem.
+class IniFile {
+ public:
+  struct Section {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> values;
+
+    // The value of |key|, or nullptr when the key is missing. An empty
+    // value is not missing.
+    const std::string* Find(std::string_view key) const {
+      for (const auto& value : values) {
+        if (IsIniNameEqual(value.first, key))
+          return &value.second;
+      }
+      return nullptr;
+    }
+
+    std::string Get(std::string_view key,
+                    std::string_view default_value = {}) const {
+      const std::string* value = Find(key);
+      return value ? *value : std::string(default_value);
+    }
+
+    // Like GetPrivateProfileInt: the leading decimal number of the value,
+    // 0 if there is none, or |default_value| when the key is missing.
+    int GetInt(std::string_view key, int default_value) const {
+      const std::string* value = Find(key);
+      if (!value)
+        return default_value;
+      size_t i = 0;
+      bool negative = i < value->size() && (*value)[i] == '-';
+      i += negative;
+      int number = 0;
+      for (; i < value->size() && (*value)[i] >= '0' && (*value)[i] <= '9';
+           ++i) {
+        number = number * 10 + ((*value)[i] - '0');
+      }
+      return negative ? -number : number;
+    }
+  };
+
+  // Parse |raw| as read from the file, in any encoding DecodeIniText takes.
+  void Parse(std::string_view raw) {
+    sections_.clear();
+    std::string text = DecodeIniText(raw);
+    std::string_view rest(text);
+    while (!rest.empty()) {
+      size_t end = rest.find('\n');
+      std::string_view line = Trim(rest.substr(0, end));
+      rest.remove_prefix(end == std::string_view::npos ? rest.size()
+                                                       : end + 1);
+
+      if (line.empty() || line[0] == ';')
+        continue;
+      if (line[0] == '[') {
+        size_t close = line.find(']');
+        sections_.push_back({std::string(Trim(line.substr(
+                                 1, close == std::string_view::npos
+                                        ? std::string_view::npos
+                                        : close - 1))),
+                             {}});
+        continue;
+      }
+      size_t equal = line.find('=');
+      if (equal == std::string_view::npos || sections_.empty())
+        continue;
+      std::string_view value = Trim(line.substr(equal + 1));
+      if (value.size() >= 2 && value.front() == value.back() &&
+          (value.front() == '"' || value.front() == '\'')) {
+        value = value.substr(1, value.size() - 2);
+      }
+      sections_.back().values.emplace_back(
+          std::string(Trim(line.substr(0, equal))), std::string(value));
+    }
+  }
+
+  // Every section in file order, including repeated names.
+  const std::vector<Section>& sections() const { return sections_; }
+
+  const Section* FindSection(std::string_view name) const {
+    for (const Section& section : sections_) {
+      if (IsIniNameEqual(section.name, name))
+        return &section;
+    }
+    return nullptr;
+  }
+
+  const std::string* Find(std::string_view section,
+                          std::string_view key) const {
+    const Section* found = FindSection(section);
+    return found ? found->Find(key) : nullptr;
+  }
+
+  std::string Get(std::string_view section,
+                  std::string_view key,
+                  std::string_view default_value = {}) const {
+    const std::string* value = Find(section, key);
+    return value ? *value : std::string(default_value);
+  }
+
+  int GetInt(std::string_view section,
+             std::string_view key,
+             int default_value) const {
+    const Section* found = FindSection(section);
+    return found ? found->GetInt(key, default_value) : default_value;
+  }
+
+ private:
+  static std::string_view Trim(std::string_view text) {
+    const char* kSpace = " \t\r\n";
+    size_t begin = text.find_first_not_of(kSpace);
+    if (begin == std::string_view::npos)
+      return {};
+    return text.substr(begin, text.find_last_not_of(kSpace) - begin + 1);
+  }
+
+  std::vector<Section> sections_;
+};
+
+#endif  // INIFILE_H_
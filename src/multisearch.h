@@ -0,0 +1,207 @@
+#ifndef MULTISEARCH_H_
+#define MULTISEARCH_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "signature.h"
+
+// Find every registered signature in a single pass over the buffer.
+//
+// The anchors of all signatures are compiled into an Aho-Corasick automaton
+// with a full 256-way transition table, so the scan is one table lookup per
+// input byte no matter how many signatures are registered. Each anchor hit
+// is then verified against the complete signature, wildcards included.
+class MultiSearcher {
+ public:
+  static const int kMaxVectorStarts = 8;
+
+  // Register a signature and return its id, or -1 if it cannot be used.
+  int Add(const Signature& signature) {
+    if (!signature.IsValid() || signature.anchor_length() == 0)
+      return -1;
+    signatures_.push_back(signature);
+    built_ = false;
+    return (int)signatures_.size() - 1;
+  }
+
+  int Add(const uint8_t* bytes, int length) {
+    return Add(Signature(bytes, length));
+  }
+
+  int size() const { return (int)signatures_.size(); }
+
+  // Build the automaton now instead of on the first scan, so that scans from
+  // several threads only read it.
+  void Compile() {
+    if (!built_)
+      Build();
+  }
+
+  // Call f(id, match) for every match of every signature, in the order their
+  // anchors end in the buffer. Overlapping matches are all reported.
+  template <typename Function>
+  void Scan(const uint8_t* s, int n, Function f) {
+    if (!s || signatures_.empty())
+      return;
+    if (!built_)
+      Build();
+
+    const int* next = next_.data();
+    const uint8_t* accepting = accepting_.data();
+    int state = 0;
+    for (int i = 0; i < n; ++i) {
+      if (state == 0) {
+        // At the root only the first bytes of the anchors lead anywhere,
+        // skip the rest without going through the transition table.
+        i = SkipToStart(s, n, i);
+        if (i == n)
+          break;
+      }
+      state = next[state * 256 + s[i]];
+      if (!accepting[state])
+        continue;
+      for (int id : outputs_[state]) {
+        const Signature& signature = signatures_[id];
+        // |i| is the last byte of the anchor.
+        int start =
+            i + 1 - signature.anchor_length() - signature.anchor_offset();
+        if (start < 0 || start + signature.size() > n)
+          continue;
+        if (signature.MatchAt(s + start))
+          f(id, s + start);
+      }
+    }
+  }
+
+  // Collect the matches of every signature, indexed by id.
+  std::vector<std::vector<const uint8_t*>> FindAll(const uint8_t* s, int n) {
+    std::vector<std::vector<const uint8_t*>> hits(signatures_.size());
+    Scan(s, n, [&](int id, const uint8_t* match) {
+      hits[id].push_back(match);
+    });
+    return hits;
+  }
+
+ private:
+  // Return the first position from |i| where an anchor may start, or n.
+  int SkipToStart(const uint8_t* s, int n, int i) const {
+#ifdef FASTSEARCH_X86
+    // Compare the first two bytes of every anchor against 16 positions at
+    // once, random data almost never leaves this loop.
+    if (!start_pairs_.empty()) {
+      __m128i first[kMaxVectorStarts];
+      __m128i second[kMaxVectorStarts];
+      const int count = (int)start_pairs_.size();
+      for (int k = 0; k < count; ++k) {
+        first[k] = _mm_set1_epi8((char)(start_pairs_[k] & 0xFF));
+        second[k] = _mm_set1_epi8((char)(start_pairs_[k] >> 8));
+      }
+      for (; i + 17 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i next = _mm_loadu_si128((const __m128i*)(s + i + 1));
+        __m128i found = _mm_setzero_si128();
+        for (int k = 0; k < count; ++k) {
+          found = _mm_or_si128(
+              found, _mm_and_si128(_mm_cmpeq_epi8(block, first[k]),
+                                   _mm_cmpeq_epi8(next, second[k])));
+        }
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(found);
+        if (mask)
+          return i + LowestBit(mask);
+      }
+    }
+#endif
+    while (i < n && !starts_[s[i]]) {
+      ++i;
+    }
+    return i;
+  }
+
+  void Build() {
+    // Build the trie, -1 marks a missing edge until the links are resolved.
+    next_.assign(256, -1);
+    outputs_.assign(1, {});
+    std::vector<int> fail(1, 0);
+    for (int id = 0; id < (int)signatures_.size(); ++id) {
+      const Signature& signature = signatures_[id];
+      int state = 0;
+      for (int i = 0; i < signature.anchor_length(); ++i) {
+        uint8_t c = signature.anchor()[i];
+        if (next_[state * 256 + c] < 0) {
+          next_[state * 256 + c] = (int)outputs_.size();
+          next_.resize(next_.size() + 256, -1);
+          outputs_.emplace_back();
+          fail.push_back(0);
+        }
+        state = next_[state * 256 + c];
+      }
+      outputs_[state].push_back(id);
+    }
+
+    // Breadth-first, turn failure links into direct transitions.
+    std::vector<int> queue;
+    for (int c = 0; c < 256; ++c) {
+      int child = next_[c];
+      if (child < 0) {
+        next_[c] = 0;
+      } else {
+        fail[child] = 0;
+        queue.push_back(child);
+      }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int state = queue[head];
+      const std::vector<int>& inherited = outputs_[fail[state]];
+      outputs_[state].insert(outputs_[state].end(), inherited.begin(),
+                             inherited.end());
+      for (int c = 0; c < 256; ++c) {
+        int child = next_[state * 256 + c];
+        int fallback = next_[fail[state] * 256 + c];
+        if (child < 0) {
+          next_[state * 256 + c] = fallback;
+        } else {
+          fail[child] = fallback;
+          queue.push_back(child);
+        }
+      }
+    }
+
+    for (int c = 0; c < 256; ++c) {
+      starts_[c] = next_[c] != 0;
+    }
+
+    // The vector filter needs two fixed bytes per anchor and only pays off
+    // for a few distinct pairs.
+    start_pairs_.clear();
+    for (const Signature& signature : signatures_) {
+      if (signature.anchor_length() < 2) {
+        start_pairs_.clear();
+        break;
+      }
+      uint16_t pair = signature.anchor()[0] | signature.anchor()[1] << 8;
+      if (std::find(start_pairs_.begin(), start_pairs_.end(), pair) ==
+          start_pairs_.end())
+        start_pairs_.push_back(pair);
+    }
+    if (start_pairs_.size() > kMaxVectorStarts)
+      start_pairs_.clear();
+    accepting_.resize(outputs_.size());
+    for (size_t state = 0; state < outputs_.size(); ++state) {
+      accepting_[state] = !outputs_[state].empty();
+    }
+    built_ = true;
+  }
+
+  std::vector<Signature> signatures_;
+  std::vector<int> next_;
+  std::vector<std::vector<int>> outputs_;
+  std::vector<uint8_t> accepting_;
+  bool starts_[256] = {};
+  std::vector<uint16_t> start_pairs_;
+  bool built_ = false;
+};
+
+#endif  // MULTISEARCH_H_
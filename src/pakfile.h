@@ -1,16 +1,31 @@
 ﻿#ifndef PAKFILE_H_
 #define PAKFILE_H_
 
+#ifdef _MSC_VER
 #pragma warning(disable : 4334)
 #pragma warning(disable : 4267)
+#endif
 
+// Nothing in here needs windows.h, so tools/pakutil.cpp builds it on Linux.
+// DebugLog comes from utils.h in the dll and from the tool otherwise.
 extern "C"
 {
-#include "..\mini_gzip\miniz.c"
-#include "..\mini_gzip\mini_gzip.h"
-#include "..\mini_gzip\mini_gzip.c"
+#include "../mini_gzip/miniz.c"
+#include "../mini_gzip/mini_gzip.h"
+#include "../mini_gzip/mini_gzip.c"
 }
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fastsearch.h"
+#include "pakrules.h"
+#include "streamsearch.h"
+
 #pragma pack(push)
 #pragma pack(1)
 
@@ -39,140 +54,913 @@ struct PAK_ALIAS {
 };
 #pragma pack(pop)
 
+// A view of bytes inside the mapped pak, nothing is copied.
+class ByteSpan {
+ public:
+  ByteSpan() = default;
+  ByteSpan(uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  uint8_t* begin() const { return data_; }
+  uint8_t* end() const { return data_ + size_; }
+
+ private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Parse and validate the header, the entry table and the PAK5 alias table.
+// Every table has to fit in the |size| mapped bytes, and every entry has to
+// point inside the data area with offsets that never go backwards, so the
+// callers can use `(entry + 1)->file_offset - entry->file_offset` as the
+// size of a resource without further checks. Resource and alias ids have to
+// be strictly increasing, PakIndex binary searches them.
 bool CheckHeader(uint8_t* buffer,
+                 size_t size,
                  PAK_ENTRY*& pak_entry,
-                 PAK_ENTRY*& end_entry) {
-  uint32_t version = *(uint32_t*)buffer;
-
-  if (version != PACK4_FILE_VERSION && version != PACK5_FILE_VERSION)
+                 PAK_ENTRY*& end_entry,
+                 PAK_ALIAS*& alias_entry,
+                 PAK_ALIAS*& alias_end) {
+  if (!buffer || size < sizeof(uint32_t))
     return false;
 
+  uint32_t version = *(uint32_t*)buffer;
+  size_t entry_count = 0;
+  size_t alias_count = 0;
+  size_t table_offset = 0;
+
   if (version == PACK4_FILE_VERSION) {
+    if (size < sizeof(uint32_t) + sizeof(PAK4_HEADER))
+      return false;
     PAK4_HEADER* pak_header = (PAK4_HEADER*)(buffer + sizeof(uint32_t));
     if (pak_header->encodeing != 1)
       return false;
 
-    pak_entry = (PAK_ENTRY*)(buffer + sizeof(uint32_t) + sizeof(PAK4_HEADER));
-    end_entry = pak_entry + pak_header->num_entries;
-  }
-
-  if (version == PACK5_FILE_VERSION) {
+    entry_count = pak_header->num_entries;
+    table_offset = sizeof(uint32_t) + sizeof(PAK4_HEADER);
+  } else if (version == PACK5_FILE_VERSION) {
+    if (size < sizeof(uint32_t) + sizeof(PAK5_HEADER))
+      return false;
     PAK5_HEADER* pak_header = (PAK5_HEADER*)(buffer + sizeof(uint32_t));
     if (pak_header->encodeing != 1)
       return false;
 
-    pak_entry = (PAK_ENTRY*)(buffer + sizeof(uint32_t) + sizeof(PAK5_HEADER));
-    end_entry = pak_entry + pak_header->resource_count;
+    entry_count = pak_header->resource_count;
+    alias_count = pak_header->alias_count;
+    table_offset = sizeof(uint32_t) + sizeof(PAK5_HEADER);
+  } else {
+    return false;
   }
 
+  // The entry table is followed by one extra entry holding the end offset
+  // of the last resource, then by the aliases.
+  size_t entries_size = (entry_count + 1) * sizeof(PAK_ENTRY);
+  size_t aliases_size = alias_count * sizeof(PAK_ALIAS);
+  if (entry_count >= size || size - table_offset < entries_size ||
+      size - table_offset - entries_size < aliases_size)
+    return false;
+
+  pak_entry = (PAK_ENTRY*)(buffer + table_offset);
+  end_entry = pak_entry + entry_count;
+  alias_entry = (PAK_ALIAS*)(buffer + table_offset + entries_size);
+  alias_end = alias_entry + alias_count;
+
   // In order to save the "next item" of the last item,
   // the id of this special item must be 0
-  if (!end_entry || end_entry->resource_id != 0)
+  if (end_entry->resource_id != 0)
     return false;
 
+  size_t data_offset = table_offset + entries_size + aliases_size;
+  uint32_t last_offset = (uint32_t)data_offset;
+  for (PAK_ENTRY* entry = pak_entry; entry <= end_entry; ++entry) {
+    if (entry->file_offset < last_offset || entry->file_offset > size)
+      return false;
+    if (entry > pak_entry && entry < end_entry &&
+        entry->resource_id <= (entry - 1)->resource_id)
+      return false;
+    last_offset = entry->file_offset;
+  }
+
+  for (PAK_ALIAS* alias = alias_entry; alias < alias_end; ++alias) {
+    if (alias->entry_index >= entry_count)
+      return false;
+    if (alias > alias_entry && alias->resource_id <= (alias - 1)->resource_id)
+      return false;
+  }
+
   return true;
 }
 
-template <typename Function>
-void PakFind(uint8_t* buffer, uint8_t* pos, Function f) {
-  PAK_ENTRY* pak_entry = nullptr;
-  PAK_ENTRY* end_entry = nullptr;
+// Lookups over the entry table of a mapped pak. Chrome writes the entries
+// and the aliases sorted by resource id, and the offsets grow with the
+// entries (its own DataPack binary searches them too), so lookups are binary
+// searches on the mapped tables and building the index copies nothing.
+class PakIndex {
+ public:
+  PakIndex(uint8_t* buffer, size_t size) : buffer_(buffer), size_(size) {
+    if (!CheckHeader(buffer, size, begin_, end_, alias_begin_, alias_end_)) {
+      begin_ = end_ = nullptr;
+      alias_begin_ = alias_end_ = nullptr;
+    }
+  }
 
-  // Check the file header.
-  if (!CheckHeader(buffer, pak_entry, end_entry))
+  bool IsValid() const { return begin_ != nullptr; }
+  size_t size() const { return end_ - begin_; }
+  PAK_ENTRY* begin() const { return begin_; }
+  PAK_ENTRY* end() const { return end_; }
+
+  // Resolve |resource_id| to the entry holding its data, following the
+  // alias table for ids that share the data of another resource.
+  PAK_ENTRY* FindById(uint16_t resource_id) const {
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (begin_[middle].resource_id < resource_id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    if (low < size() && begin_[low].resource_id == resource_id)
+      return begin_ + low;
+
+    PAK_ALIAS* alias = FindAlias(resource_id);
+    if (alias)
+      return begin_ + alias->entry_index;
+    return nullptr;
+  }
+
+  // Whether |resource_id| is only an alias of another resource.
+  bool IsAlias(uint16_t resource_id) const {
+    return FindAlias(resource_id) != nullptr;
+  }
+
+  // The entry whose data contains |offset|.
+  PAK_ENTRY* FindByOffset(uint32_t offset) const {
+    // Find the last entry that starts at or before |offset|.
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (begin_[middle].file_offset <= offset)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    if (low == 0)
+      return nullptr;
+    PAK_ENTRY* entry = begin_ + low - 1;
+    if (offset >= (entry + 1)->file_offset)
+      return nullptr;
+    return entry;
+  }
+
+  uint8_t* GetData(const PAK_ENTRY* entry) const {
+    return buffer_ + entry->file_offset;
+  }
+
+  uint32_t GetSize(const PAK_ENTRY* entry) const {
+    return (entry + 1)->file_offset - entry->file_offset;
+  }
+
+  ByteSpan GetSpan(const PAK_ENTRY* entry) const {
+    return ByteSpan(GetData(entry), GetSize(entry));
+  }
+
+  // The data of a resource, or an empty span if there is no such id.
+  ByteSpan GetResource(uint16_t resource_id) const {
+    PAK_ENTRY* entry = FindById(resource_id);
+    return entry ? GetSpan(entry) : ByteSpan();
+  }
+
+ private:
+  PAK_ALIAS* FindAlias(uint16_t resource_id) const {
+    size_t low = 0;
+    size_t high = alias_end_ - alias_begin_;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (alias_begin_[middle].resource_id < resource_id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    if (alias_begin_ + low < alias_end_ &&
+        alias_begin_[low].resource_id == resource_id)
+      return alias_begin_ + low;
+    return nullptr;
+  }
+
+  uint8_t* buffer_;
+  size_t size_;
+  PAK_ENTRY* begin_ = nullptr;
+  PAK_ENTRY* end_ = nullptr;
+  PAK_ALIAS* alias_begin_ = nullptr;
+  PAK_ALIAS* alias_end_ = nullptr;
+};
+
+template <typename Function>
+void PakFind(uint8_t* buffer, size_t size, uint8_t* pos, Function f) {
+  PakIndex index(buffer, size);
+  if (!index.IsValid() || pos < buffer || pos >= buffer + size)
     return;
 
-  do {
-    PAK_ENTRY* next_entry = pak_entry + 1;
-    if (pos >= buffer + pak_entry->file_offset &&
-        pos <= buffer + next_entry->file_offset) {
-      f(buffer + pak_entry->file_offset,
-        next_entry->file_offset - pak_entry->file_offset);
-      break;
+  PAK_ENTRY* entry = index.FindByOffset((uint32_t)(pos - buffer));
+  if (entry)
+    f(index.GetData(entry), index.GetSize(entry));
+}
+
+// Call f(data, size) for the resource with |resource_id|.
+template <typename Function>
+bool PakFindById(uint8_t* buffer,
+                 size_t size,
+                 uint16_t resource_id,
+                 Function f) {
+  PakIndex index(buffer, size);
+  PAK_ENTRY* entry = index.FindById(resource_id);
+  if (!entry)
+    return false;
+  f(index.GetData(entry), index.GetSize(entry));
+  return true;
+}
+
+// Deflate cannot expand data by more than about 1032:1, a gzip trailer that
+// claims more than that (or more than this cap) is corrupt.
+const uint32_t kMaxGzipRatio = 1032;
+const uint32_t kMaxInflatedSize = 256 * 1024 * 1024;
+
+// Read the ISIZE trailer of a gzip member, 0 if it is not plausible.
+uint32_t GetGzipOriginalSize(const uint8_t* data, uint32_t size) {
+  // 10 bytes of header and 8 bytes of trailer at least.
+  if (size < 18)
+    return 0;
+  uint32_t original_size = 0;
+  memcpy(&original_size, data + size - 4, sizeof(original_size));
+  if (original_size == 0 || original_size > kMaxInflatedSize ||
+      original_size / kMaxGzipRatio > size)
+    return 0;
+  return original_size;
+}
+
+// Size of the gzip member header, including the optional fields, 0 if it
+// is not a deflate member.
+size_t GetGzipHeaderSize(const uint8_t* data, size_t size) {
+  if (size < 18 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 0x08)
+    return 0;
+
+  uint8_t flags = data[3];
+  size_t offset = 10;
+  if (flags & 0x04) {
+    // FEXTRA
+    if (offset + 2 > size)
+      return 0;
+    offset += 2 + (data[offset] | data[offset + 1] << 8);
+  }
+  for (uint8_t field : {0x08, 0x10}) {
+    // FNAME and FCOMMENT are zero terminated.
+    if (!(flags & field))
+      continue;
+    while (offset < size && data[offset])
+      ++offset;
+    ++offset;
+  }
+  if (flags & 0x02) {
+    // FHCRC
+    offset += 2;
+  }
+  return offset < size ? offset : 0;
+}
+
+// Inflate state for one worker. The output goes through the 32 KB window
+// that deflate back-references need anyway, so scanning a resource never
+// allocates more than this.
+struct GzipScanner {
+  tinfl_decompressor decompressor;
+  uint8_t window[TINFL_LZ_DICT_SIZE];
+};
+
+// Inflate a gzip member through the window of |scanner| and feed the output
+// to |searchers|. Return true as soon as one of the needles shows up.
+bool GzipStreamContains(const uint8_t* data,
+                        size_t size,
+                        GzipScanner& scanner,
+                        std::vector<StreamSearcher>& searchers) {
+  size_t header_size = GetGzipHeaderSize(data, size);
+  if (header_size == 0)
+    return false;
+
+  const uint8_t* input = data + header_size;
+  size_t input_left = size - header_size;
+  size_t window_offset = 0;
+  uint64_t total = 0;
+  bool found = false;
+
+  tinfl_init(&scanner.decompressor);
+  for (StreamSearcher& searcher : searchers) {
+    searcher.Reset();
+  }
+  while (true) {
+    size_t input_size = input_left;
+    size_t output_size = TINFL_LZ_DICT_SIZE - window_offset;
+    tinfl_status status = tinfl_decompress(
+        &scanner.decompressor, input, &input_size, scanner.window,
+        scanner.window + window_offset, &output_size, 0);
+    input += input_size;
+    input_left -= input_size;
+
+    total += output_size;
+    for (StreamSearcher& searcher : searchers) {
+      if (output_size &&
+          !searcher.Feed(scanner.window + window_offset, (int)output_size,
+                         [&](uint64_t) {
+                           found = true;
+                           return false;
+                         })) {
+        return found;
+      }
+    }
+    window_offset = (window_offset + output_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+    // Done, corrupt, or more output than the trailer check would allow.
+    if (status != TINFL_STATUS_HAS_MORE_OUTPUT || total > kMaxInflatedSize)
+      return false;
+  }
+}
+
+// Stored blocks and fixed Huffman codes, reported in place of a level.
+const int kGzipStored = 0;
+const int kGzipFixedHuffman = 10;
+
+// Encodings tried from the cheapest up. The last ones only run after the
+// data has been squeezed once more, when the rules allow it.
+struct GzipAttempt {
+  int level;
+  bool squeeze;
+};
+
+const GzipAttempt kGzipAttempts[] = {
+    {1, false}, {3, false}, {6, false}, {9, false},
+    {9, true},  {kGzipFixedHuffman, true}, {kGzipStored, true},
+};
+
+// Every allocation made by the pak arenas. Once the pool is warm, patching
+// leaves these unchanged.
+std::atomic<uint64_t> pak_arena_allocations(0);
+std::atomic<uint64_t> pak_arena_allocated_bytes(0);
+
+struct PakArenaStats {
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+};
+
+PakArenaStats GetPakArenaStats() {
+  return {pak_arena_allocations.load(), pak_arena_allocated_bytes.load()};
+}
+
+void* PakArenaAllocate(size_t size) {
+  pak_arena_allocations.fetch_add(1, std::memory_order_relaxed);
+  pak_arena_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  return malloc(size);
+}
+
+// A buffer that only grows, so it ends up the size of the largest resource.
+class PakScratch {
+ public:
+  PakScratch() = default;
+  PakScratch(const PakScratch&) = delete;
+  PakScratch& operator=(const PakScratch&) = delete;
+  ~PakScratch() { free(data_); }
+
+  uint8_t* Reserve(size_t size) {
+    if (size > capacity_) {
+      free(data_);
+      // Round up so slightly larger resources do not grow it again.
+      capacity_ = (size + 0xFFFF) & ~(size_t)0xFFFF;
+      data_ = (uint8_t*)PakArenaAllocate(capacity_);
+      if (!data_)
+        capacity_ = 0;
+    }
+    return data_;
+  }
+
+ private:
+  uint8_t* data_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+// Everything one traversal worker needs to patch resources: the inflate and
+// deflate states, the streaming pre-scan and two scratch buffers. The
+// deflate state is several hundred KB and only allocated once a resource
+// is actually recompressed.
+class PakArena {
+ public:
+  PakArena() = default;
+  PakArena(const PakArena&) = delete;
+  PakArena& operator=(const PakArena&) = delete;
+  ~PakArena() {
+    free(scanner_);
+    free(compressor_);
+  }
+
+  PakScratch& inflated() { return inflated_; }
+  PakScratch& backup() { return backup_; }
+
+  GzipScanner* scanner() {
+    if (!scanner_)
+      scanner_ = (GzipScanner*)PakArenaAllocate(sizeof(GzipScanner));
+    return scanner_;
+  }
+
+  tdefl_compressor* compressor() {
+    if (!compressor_)
+      compressor_ =
+          (tdefl_compressor*)PakArenaAllocate(sizeof(tdefl_compressor));
+    return compressor_;
+  }
+
+  // Stream searchers for |triggers|, rebuilt only when the triggers change.
+  std::vector<StreamSearcher>& searchers(
+      const std::vector<Searcher>& triggers) {
+    bool same = triggers.size() == trigger_patterns_.size();
+    for (size_t i = 0; same && i < triggers.size(); ++i) {
+      same = trigger_patterns_[i] == triggers[i].pattern();
+    }
+    if (!same) {
+      pak_arena_allocations.fetch_add(1, std::memory_order_relaxed);
+      searchers_.clear();
+      trigger_patterns_.clear();
+      for (const Searcher& trigger : triggers) {
+        searchers_.emplace_back(trigger.pattern(), trigger.size());
+        trigger_patterns_.push_back(trigger.pattern());
+      }
+    }
+    return searchers_;
+  }
+
+ private:
+  PakScratch inflated_;
+  PakScratch backup_;
+  GzipScanner* scanner_ = nullptr;
+  tdefl_compressor* compressor_ = nullptr;
+  std::vector<StreamSearcher> searchers_;
+  std::vector<const uint8_t*> trigger_patterns_;
+};
+
+// Arenas are handed to the workers of each traversal and kept afterwards,
+// so later traversals start warm. Trim releases them once patching is done.
+class PakArenaPool {
+ public:
+  std::unique_ptr<PakArena> Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (arenas_.empty()) {
+      pak_arena_allocations.fetch_add(1, std::memory_order_relaxed);
+      return std::unique_ptr<PakArena>(new PakArena);
+    }
+    std::unique_ptr<PakArena> arena = std::move(arenas_.back());
+    arenas_.pop_back();
+    return arena;
+  }
+
+  void Release(std::unique_ptr<PakArena> arena) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    arenas_.reserve(kMaxArenas);
+    if (arenas_.size() < kMaxArenas)
+      arenas_.push_back(std::move(arena));
+  }
+
+  void Trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    arenas_.clear();
+    arenas_.shrink_to_fit();
+  }
+
+ private:
+  static const size_t kMaxArenas = 16;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<PakArena>> arenas_;
+};
+
+PakArenaPool& GetPakArenaPool() {
+  static PakArenaPool pool;
+  return pool;
+}
+
+// Inflate a whole gzip member into |output|, which holds |output_size|
+// bytes, and check that it fills it exactly.
+bool GzipInflate(const uint8_t* data,
+                 size_t size,
+                 uint8_t* output,
+                 size_t output_size,
+                 tinfl_decompressor* decompressor) {
+  size_t header_size = GetGzipHeaderSize(data, size);
+  if (header_size == 0)
+    return false;
+
+  size_t input_size = size - header_size;
+  size_t inflated = output_size;
+  tinfl_init(decompressor);
+  tinfl_status status = tinfl_decompress(
+      decompressor, data + header_size, &input_size, output, output, &inflated,
+      TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  return status == TINFL_STATUS_DONE && inflated == output_size;
+}
+
+// Fill |size| bytes, at least 2, with empty deflate blocks, the last one
+// final. Appended to a sync flushed stream, which ends on a byte boundary,
+// it completes the stream without adding any output.
+void WriteDeflatePadding(uint8_t* p, size_t size) {
+  // Empty stored blocks: a header byte, then LEN 0 and NLEN 0xFFFF.
+  const uint8_t kStored[] = {0x00, 0x00, 0x00, 0xFF, 0xFF};
+  while (size > 6) {
+    memcpy(p, kStored, sizeof(kStored));
+    p += sizeof(kStored);
+    size -= sizeof(kStored);
+  }
+
+  // 2 to 6 bytes left. An empty fixed Huffman block is 10 bits: 3 header
+  // bits and the 7 bit end of block code, all zero but BTYPE. Either chain
+  // 1 to 3 of them, or end on an empty stored block.
+  bool stored = size >= 5;
+  int fixed = stored ? (int)size - 5 : (int)size - 1;
+  uint32_t bits = 0;
+  int count = 0;
+  for (int i = 0; i < fixed; ++i) {
+    if (!stored && i == fixed - 1)
+      bits |= 1u << count;  // BFINAL
+    bits |= 1u << (count + 1);  // BTYPE 01
+    count += 10;
+  }
+  if (stored) {
+    bits |= 1u << count;  // BFINAL, BTYPE 00
+    count += 3;
+  }
+  for (int i = 0; i < count; i += 8) {
+    *p++ = (uint8_t)(bits >> i);
+  }
+  if (stored)
+    memcpy(p, kStored + 1, 4);
+}
+
+// Deflate |data| into a gzip member that fills the |slot_size| bytes at
+// |slot| exactly, trying the encodings of kGzipAttempts in order. The
+// deflate output is written straight into the slot and bounded by it, so an
+// encoding that does not fit stops instead of overflowing. The stream is
+// sync flushed rather than finished and the rest of the slot is filled with
+// empty blocks, so no padding has to be laid out ahead of the data. Return
+// the winning level and the bytes of actual output in |compress_size|, or
+// -1 if none fits, in which case the slot is left clobbered. Unless
+// |squeeze| is kMinifyNone, the whitespace of |data| may be minified with
+// it and |size| updated; otherwise the squeezed level 9 attempt is skipped.
+int GzipCompressIntoSlot(uint8_t* data,
+                         uint32_t& size,
+                         MinifyMode squeeze,
+                         uint8_t* slot,
+                         size_t slot_size,
+                         tdefl_compressor* compressor,
+                         size_t& compress_size) {
+  // 10 bytes of header, 8 bytes of trailer and at least 2 of padding.
+  if (slot_size < 20)
+    return -1;
+  const size_t room = slot_size - 18;
+
+  bool squeezed = false;
+  for (const GzipAttempt& attempt : kGzipAttempts) {
+    if (attempt.squeeze && !squeezed) {
+      // Without squeezing this is the level 9 attempt again.
+      if (squeeze == kMinifyNone && attempt.level == 9)
+        continue;
+      size = MinifyWhitespace(data, size, squeeze);
+      squeezed = true;
+    }
+
+    int strategy = MZ_DEFAULT_STRATEGY;
+    int zip_level = attempt.level;
+    if (attempt.level == kGzipFixedHuffman) {
+      strategy = MZ_FIXED;
+      zip_level = 9;
     }
+    // Negative window bits: raw deflate, the gzip framing is written here.
+    mz_uint flags = tdefl_create_comp_flags_from_zip_params(
+        zip_level, -MZ_DEFAULT_WINDOW_BITS, strategy);
+
+    // One byte short of the padding, so a full buffer means it did not fit,
+    // possibly with output still pending.
+    size_t input_size = size;
+    size_t deflate_size = room - 1;
+    tdefl_init(compressor, nullptr, nullptr, (int)flags);
+    tdefl_status status = tdefl_compress(compressor, data, &input_size,
+                                         slot + 10, &deflate_size,
+                                         TDEFL_SYNC_FLUSH);
+    if (status != TDEFL_STATUS_OKAY || input_size != size ||
+        deflate_size >= room - 1)
+      continue;
+
+    WriteDeflatePadding(slot + 10 + deflate_size, room - deflate_size);
+
+    const uint8_t header[10] = {0x1F, 0x8B, 0x08, 0, 0, 0, 0, 0, 0, 0xFF};
+    memcpy(slot, header, sizeof(header));
+    uint32_t crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, data, size);
+    memcpy(slot + slot_size - 8, &crc, sizeof(crc));
+    memcpy(slot + slot_size - 4, &size, sizeof(size));
 
-    pak_entry = next_entry;
-  } while (pak_entry->resource_id != 0);
+    compress_size = deflate_size + 18;
+    return attempt.level;
+  }
+  return -1;
 }
 
+// One gzip resource and, once patched, the level it was recompressed at.
+struct GZIPJob {
+  PAK_ENTRY* entry;
+  bool scan;
+  bool patched;
+  int level;
+};
+
+// Inflate one resource, let f patch it and deflate the result straight
+// into the original slot if it fits. |original| holds the unmodified bytes
+// of the slot, used to put them back when nothing fits; without it they are
+// copied aside first. All memory comes from |arena|.
 template <typename Function>
-void TraversalGZIPFile(uint8_t* buffer, Function f) {
-  PAK_ENTRY* pak_entry = NULL;
-  PAK_ENTRY* end_entry = NULL;
+void PatchGZIPResource(const PakIndex& index,
+                       GZIPJob& job,
+                       Function& f,
+                       PakArena& arena,
+                       const uint8_t* original) {
+  uint8_t* data = index.GetData(job.entry);
+  uint32_t old_size = index.GetSize(job.entry);
+
+  uint32_t original_size = GetGzipOriginalSize(data, old_size);
+  if (original_size == 0) {
+    DebugLog(L"gzip trailer error %d %d", job.entry->resource_id, old_size);
+    return;
+  }
 
-  // Check the file header.
-  if (!CheckHeader(buffer, pak_entry, end_entry))
+  uint8_t* unpack_buffer = arena.inflated().Reserve(original_size);
+  if (!unpack_buffer ||
+      !GzipInflate(data, old_size, unpack_buffer, original_size,
+                   &arena.scanner()->decompressor))
     return;
 
-  do {
-    PAK_ENTRY* next_entry = pak_entry + 1;
-    uint32_t old_size = next_entry->file_offset - pak_entry->file_offset;
+  uint32_t new_len = old_size;
+  MinifyMode squeeze = kMinifyNone;
+  bool changed = f(job.entry->resource_id, unpack_buffer, original_size,
+                   new_len, squeeze);
+  if (!changed)
+    return;
+
+  if (!original) {
+    uint8_t* backup = arena.backup().Reserve(old_size);
+    if (!backup)
+      return;
+    memcpy(backup, data, old_size);
+    original = backup;
+  }
+
+  // Resources occupy disjoint byte ranges, so the worker writes its own.
+  size_t compress_size = 0;
+  int level = GzipCompressIntoSlot(unpack_buffer, new_len, squeeze, data,
+                                   old_size, arena.compressor(),
+                                   compress_size);
+  if (level < 0) {
+    DebugLog(L"gzip compress error %d %d", job.entry->resource_id, old_size);
+    memcpy(data, original, old_size);
+    return;
+  }
+
+  DebugLog(L"gzip level %d for %d: %d of %d", level, job.entry->resource_id,
+           (int)compress_size, old_size);
+  job.patched = true;
+  job.level = level;
+}
 
-    if (old_size < 10 * 1024) {
+const unsigned kTraversalMaxThreads = 8;
+
+// Inflate every gzip resource of 10 KB or more that select(id) does not
+// skip, let f(id, data, size, new_len, squeeze) patch it and write the
+// recompressed result back into the pak. f sets |squeeze| to the minify
+// mode that may be applied on top when the result does not fit. Return the
+// ids of the resources that were rewritten, in entry order.
+//
+// Resources selected with kPakScan are first inflated through a fixed
+// window, and only the ones that contain one of the |triggers| are inflated
+// in full and passed to f, so scanning the pak takes a small constant
+// amount of memory per worker instead of the size of the largest resource.
+//
+// Resources occupy disjoint byte ranges, so they are processed on up to
+// |threads| workers (0 picks one per core) and f may be called concurrently
+// from several threads. Each worker takes an arena from the pool, so once
+// the pool is warm patching does not allocate.
+//
+// |pristine| is an optional read-only view of the same bytes that writes to
+// |buffer| do not reach, such as a second view of a copy-on-write mapping.
+// It lets a resource that cannot be recompressed be restored without
+// copying every slot aside before it is overwritten.
+template <typename Select, typename Function>
+std::vector<uint16_t> TraversalGZIPResources(
+    uint8_t* buffer,
+    size_t size,
+    Select select,
+    const std::vector<Searcher>& triggers,
+    Function f,
+    unsigned threads = 0,
+    const uint8_t* pristine = nullptr) {
+  std::vector<uint16_t> patched_ids;
+
+  // Check the file header.
+  PakIndex index(buffer, size);
+  if (!index.IsValid())
+    return patched_ids;
+
+  // Aliases share the entry of their target, so each payload is visited
+  // exactly once.
+  std::vector<GZIPJob> jobs;
+  for (PAK_ENTRY* pak_entry = index.begin(); pak_entry < index.end();
+       ++pak_entry) {
+    if (index.GetSize(pak_entry) < 10 * 1024) {
       // Files smaller than 10 kb are skipped.
-      pak_entry = next_entry;
       continue;
     }
 
-    BYTE gzip[] = {0x1F, 0x8B, 0x08};
+    uint8_t gzip[] = {0x1F, 0x8B, 0x08};
     size_t gzip_len = sizeof(gzip);
-    if (memcmp(buffer + pak_entry->file_offset, gzip, gzip_len) != 0) {
+    if (memcmp(index.GetData(pak_entry), gzip, gzip_len) != 0) {
       // Files that are not gzip format are skipped.
-      pak_entry = next_entry;
       continue;
     }
 
-    uint32_t original_size = *(uint32_t*)(buffer + next_entry->file_offset - 4);
-    uint8_t* unpack_buffer = (uint8_t*)malloc(original_size);
-    if (!unpack_buffer)
-      return;
+    PakSelect selected = select(pak_entry->resource_id);
+    if (selected == kPakSkip)
+      continue;
 
-    struct mini_gzip gz;
-    mini_gz_start(&gz, buffer + pak_entry->file_offset, old_size);
-    int unpack_len = mini_gz_unpack(&gz, unpack_buffer, original_size);
-
-    if (original_size == unpack_len) {
-      uint32_t new_len = old_size;
-      bool changed = f(unpack_buffer, unpack_len, new_len);
-      if (changed) {
-        // If the file is changed.
-        size_t compress_size = 0;
-        uint8_t* compress_buffer =
-            (uint8_t*)gzip_compress(unpack_buffer, new_len, &compress_size);
-        if (compress_buffer && compress_size < old_size) {
-          /*FILE *fp = fopen("test.gz", "wb");
-                    fwrite(compress_buffer, compress_size, 1, fp);
-                    fclose(fp);*/
-
-          // gzip header
-          memcpy(buffer + pak_entry->file_offset, compress_buffer, 10);
-
-          // extra
-          buffer[pak_entry->file_offset + 3] = 0x04;
-          uint16_t extra_length = old_size - compress_size - 2;
-          memcpy(buffer + pak_entry->file_offset + 10, &extra_length,
-                 sizeof(extra_length));
-          memset(buffer + pak_entry->file_offset + 12, '\0', extra_length);
-
-          // compress
-          memcpy(buffer + pak_entry->file_offset + 12 + extra_length,
-                 compress_buffer + 10, compress_size - 10);
-
-          /*fp = fopen("test2.gz", "wb");
-                    fwrite(buffer + pak_entry->file_offset, old_size, 1, fp);
-                    fclose(fp);*/
-        } else {
-          DebugLog(L"gzip compress error %d %d", compress_size, old_size);
-        }
-
-        if (compress_buffer)
-          free(compress_buffer);
-      }
+    jobs.push_back({pak_entry, selected == kPakScan, false, -1});
+  }
+
+  if (threads == 0) {
+    threads = (std::min)((std::max)(std::thread::hardware_concurrency(), 1u),
+                         kTraversalMaxThreads);
+  }
+  threads = std::min<unsigned>(threads, (unsigned)jobs.size());
+
+  std::atomic<size_t> next_job(0);
+  auto worker = [&]() {
+    std::unique_ptr<PakArena> arena = GetPakArenaPool().Acquire();
+    std::vector<StreamSearcher>& searchers = arena->searchers(triggers);
+
+    size_t i;
+    while ((i = next_job.fetch_add(1)) < jobs.size()) {
+      if (jobs[i].scan && !searchers.empty() &&
+          !GzipStreamContains(index.GetData(jobs[i].entry),
+                              index.GetSize(jobs[i].entry), *arena->scanner(),
+                              searchers))
+        continue;
+      uint8_t* data = index.GetData(jobs[i].entry);
+      PatchGZIPResource(index, jobs[i], f, *arena,
+                        pristine ? pristine + (data - buffer) : nullptr);
     }
+    GetPakArenaPool().Release(std::move(arena));
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  for (const GZIPJob& job : jobs) {
+    if (job.patched)
+      patched_ids.push_back(job.entry->resource_id);
+  }
+  return patched_ids;
+}
+
+template <typename Function>
+std::vector<uint16_t> TraversalGZIPFile(uint8_t* buffer,
+                                        size_t size,
+                                        Function f,
+                                        unsigned threads = 0) {
+  return TraversalGZIPResources(
+      buffer, size, [](uint16_t) { return kPakPatch; },
+      std::vector<Searcher>(), f, threads);
+}
+
+// FNV-1a over the header, entry and alias tables. Any Chrome update that
+// changes a resource changes an offset in there.
+uint64_t HashPakTables(uint8_t* buffer, size_t size) {
+  PakIndex index(buffer, size);
+  if (!index.IsValid())
+    return 0;
+
+  uint64_t hash = 0xCBF29CE484222325ull;
+  uint32_t tables_size = index.end()->file_offset;
+  if (index.size())
+    tables_size = index.begin()->file_offset;
+  for (uint32_t i = 0; i < tables_size; ++i) {
+    hash = (hash ^ buffer[i]) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// Identifies one resources.pak together with the patch rules applied to it.
+// Any Chrome update changes the size, the write time (a FILETIME) or an
+// offset in the entry tables.
+struct PakKey {
+  uint64_t size;
+  uint64_t mtime;
+  uint64_t tables_hash;
+  uint64_t rules_hash;
+};
+
+// The key of the pak in |buffer| as patched by |rewriter|, the same in the
+// dll and pakutil. |mtime| is a FILETIME.
+PakKey MakePakKey(uint8_t* buffer,
+                  size_t size,
+                  uint64_t mtime,
+                  const PakRewriter& rewriter) {
+  return {size, mtime, HashPakTables(buffer, size), rewriter.Hash()};
+}
+
+// A patched pak saved as a sidecar file ends with the key of the original
+// pak. Chrome ignores bytes after the last resource.
+const uint32_t kPakCacheMagic = 0x48435043;  // "CPCH"
+
+struct PakCacheTrailer {
+  PakKey key;
+  uint32_t magic;
+  uint32_t reserved;
+};
 
-    free(unpack_buffer);
-    pak_entry = next_entry;
-  } while (pak_entry->resource_id != 0);
+// Whether a sidecar of |file_size| bytes that ends with the |tail_size|
+// bytes at |tail| is the cache of the pak identified by |key|.
+bool IsPakCacheFor(uint64_t file_size,
+                   const void* tail,
+                   size_t tail_size,
+                   const PakKey& key) {
+  PakCacheTrailer trailer;
+  if (file_size != key.size + sizeof(trailer) || tail_size != sizeof(trailer))
+    return false;
+  memcpy(&trailer, tail, sizeof(trailer));
+  return trailer.magic == kPakCacheMagic &&
+         memcmp(&trailer.key, &key, sizeof(key)) == 0;
+}
+
+// The bytes of one patched resource at |offset| in the pak.
+struct PakPatchedSlot {
+  size_t offset;
+  std::vector<uint8_t> bytes;
+};
+
+// Copy the slots of the |patched| resources out of |buffer|, in file order.
+// They are all a sidecar needs besides the original pak.
+std::vector<PakPatchedSlot> CopyPatchedSlots(
+    uint8_t* buffer,
+    size_t size,
+    const std::vector<uint16_t>& patched) {
+  std::vector<PakPatchedSlot> slots;
+  PakIndex index(buffer, size);
+  if (!index.IsValid())
+    return slots;
+  for (uint16_t id : patched) {
+    PAK_ENTRY* entry = index.FindById(id);
+    if (!entry)
+      continue;
+    const uint8_t* data = index.GetData(entry);
+    slots.push_back({(size_t)(data - buffer),
+                     std::vector<uint8_t>(data, data + index.GetSize(entry))});
+  }
+  std::sort(slots.begin(), slots.end(),
+            [](const PakPatchedSlot& a, const PakPatchedSlot& b) {
+              return a.offset < b.offset;
+            });
+  return slots;
+}
+
+// Write a sidecar through write(data, size): the |size| bytes of the
+// original pak at |pristine| with |slots| laid over them, then the trailer
+// for |key|. Return false as soon as a write fails.
+template <typename Write>
+bool WritePakCache(const uint8_t* pristine,
+                   size_t size,
+                   const std::vector<PakPatchedSlot>& slots,
+                   const PakKey& key,
+                   Write write) {
+  size_t cursor = 0;
+  for (const PakPatchedSlot& slot : slots) {
+    if (slot.offset < cursor || slot.offset + slot.bytes.size() > size)
+      return false;
+    if (!write(pristine + cursor, slot.offset - cursor) ||
+        !write(slot.bytes.data(), slot.bytes.size()))
+      return false;
+    cursor = slot.offset + slot.bytes.size();
+  }
+  PakCacheTrailer trailer = {key, kPakCacheMagic, 0};
+  return write(pristine + cursor, size - cursor) &&
+         write(&trailer, sizeof(trailer));
 }
 
 #endif  // PAKFILE_H_
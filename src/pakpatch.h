@@ -1,84 +1,291 @@
-#ifndef PAKPATCH_H_
+﻿#ifndef PAKPATCH_H_
 #define PAKPATCH_H_
 
 #include "pakfile.h"
 
-DWORD resources_pak_size = 0;
-HANDLE resources_pak_map = nullptr;
-HANDLE resources_pak_file = nullptr;
+// A pak file Chrome opens and the rules for it: every rule whose pattern
+// matches its path, merged in the order they were read.
+struct PakTarget {
+  std::wstring path;
+  PakRewriter rewriter;
+};
+
+// Read once before any pak is opened.
+PakRuleSet pak_rules;
+
+const std::wstring kPakRulesPath = GetAppDir() + L"\\chrome++.pakrules";
+
+// Add the [pak_patch*] sections of an INI file, see ReadPakRule.
+void LoadPakRules(const std::wstring& path) {
+  IniFile ini;
+  if (!LoadIniFile(path, ini))
+    return;
+  for (const std::string& name : pak_rules.AddIniFile(ini)) {
+    DebugLog(L"Invalid pak rule %s", Utf8ToWide(name).c_str());
+  }
+}
+
+void ReadPakRules() {
+  pak_rules.AddBuiltinRules();
+  LoadPakRules(kIniPath);
+  LoadPakRules(kPakRulesPath);
+}
 
 auto RawCreateFile = CreateFileW;
 auto RawCreateFileMapping = CreateFileMappingW;
 auto RawMapViewOfFile = MapViewOfFile;
 
-HANDLE WINAPI MyMapViewOfFile(_In_ HANDLE hFileMappingObject,
-                              _In_ DWORD dwDesiredAccess,
-                              _In_ DWORD dwFileOffsetHigh,
-                              _In_ DWORD dwFileOffsetLow,
-                              _In_ SIZE_T dwNumberOfBytesToMap) {
-  if (hFileMappingObject == resources_pak_map) {
-    // Modify it to be modifiable.
-    LPVOID buffer =
-        RawMapViewOfFile(hFileMappingObject, FILE_MAP_COPY, dwFileOffsetHigh,
-                         dwFileOffsetLow, dwNumberOfBytesToMap);
+// The tables are hashed through the read-only view, only their pages are
+// touched.
+bool GetPakKey(HANDLE file,
+               const uint8_t* view,
+               const PakRewriter& rewriter,
+               PakKey& key) {
+  LARGE_INTEGER size;
+  FILETIME write_time;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 ||
+      !GetFileTime(file, nullptr, nullptr, &write_time))
+    return false;
 
-    // No more hook needed.
-    resources_pak_map = nullptr;
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourDetach((LPVOID*)&RawMapViewOfFile, MyMapViewOfFile);
-    auto status = DetourTransactionCommit();
-    if (status != NO_ERROR) {
-      DebugLog(L"Unhook RawMapViewOfFile failed %d", status);
+  uint64_t mtime =
+      (uint64_t)write_time.dwHighDateTime << 32 | write_time.dwLowDateTime;
+  key = MakePakKey((uint8_t*)view, (size_t)size.QuadPart, mtime, rewriter);
+  return key.tables_hash != 0;
+}
+
+// Remember which resources of a pak were patched, in chrome++.<name>.pakhits
+// next to the exe. The next launch only inflates those instead of every
+// large resource in the pak.
+const uint32_t kPakHitsMagic = 0x53544948;  // "HITS"
+
+std::wstring GetPakHitsPath(const std::wstring& pak_path) {
+  std::wstring name = pak_path.substr(pak_path.find_last_of(L"\\/") + 1);
+  return GetAppDir() + L"\\chrome++." + name.substr(0, name.rfind(L'.')) +
+         L".pakhits";
+}
+
+bool LoadPakHits(const std::wstring& path,
+                 const PakKey& key,
+                 std::vector<uint16_t>& ids) {
+  FILE* fp = nullptr;
+  if (_wfopen_s(&fp, path.c_str(), L"rb") != 0 || !fp)
+    return false;
+  bool loaded = false;
+  uint32_t magic = 0;
+  PakKey saved_key;
+  uint32_t count = 0;
+  if (fread(&magic, sizeof(magic), 1, fp) == 1 && magic == kPakHitsMagic &&
+      fread(&saved_key, sizeof(saved_key), 1, fp) == 1 &&
+      memcmp(&saved_key, &key, sizeof(key)) == 0 &&
+      fread(&count, sizeof(count), 1, fp) == 1 && count <= 0xFFFF) {
+    ids.resize(count);
+    loaded = count == 0 ||
+             fread(ids.data(), sizeof(uint16_t), count, fp) == count;
+  }
+  fclose(fp);
+  return loaded;
+}
+
+void SavePakHits(const std::wstring& path,
+                 const PakKey& key,
+                 const std::vector<uint16_t>& ids) {
+  FILE* fp = nullptr;
+  if (_wfopen_s(&fp, path.c_str(), L"wb") != 0 || !fp) {
+    DebugLog(L"Save pak hits failed");
+    return;
+  }
+
+  uint32_t count = (uint32_t)ids.size();
+  fwrite(&kPakHitsMagic, sizeof(kPakHitsMagic), 1, fp);
+  fwrite(&key, sizeof(key), 1, fp);
+  fwrite(&count, sizeof(count), 1, fp);
+  if (count)
+    fwrite(ids.data(), sizeof(uint16_t), count, fp);
+  fclose(fp);
+}
+
+// The patched pak is saved next to the original with the key of the
+// original appended, Chrome ignores bytes after the last resource. Later
+// launches hand Chrome the sidecar instead, so its pages stay file backed
+// and shared and nothing is inflated at startup.
+const wchar_t kPakCacheSuffix[] = L".patched";
+
+HANDLE OpenPakCache(const std::wstring& path, const PakKey& key) {
+  HANDLE file = RawCreateFile(
+      path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return file;
+
+  LARGE_INTEGER size;
+  LARGE_INTEGER offset;
+  PakCacheTrailer trailer;
+  DWORD read = 0;
+  if (GetFileSizeEx(file, &size) &&
+      (uint64_t)size.QuadPart == key.size + sizeof(trailer)) {
+    offset.QuadPart = key.size;
+    if (SetFilePointerEx(file, offset, nullptr, FILE_BEGIN) &&
+        ReadFile(file, &trailer, sizeof(trailer), &read, nullptr) &&
+        IsPakCacheFor(size.QuadPart, &trailer, read, key)) {
+      offset.QuadPart = 0;
+      SetFilePointerEx(file, offset, nullptr, FILE_BEGIN);
+      return file;
     }
+  }
 
-    if (buffer) {
-      // Traverse the gzip file.
-      TraversalGZIPFile((BYTE*)buffer, [=](uint8_t* begin, uint32_t size,
-                                           uint32_t& new_len) {
-        bool changed = false;
-
-        BYTE search_start[] = R"(</settings-about-page>)";
-        uint8_t* pos =
-            memmem(begin, size, search_start, sizeof(search_start) - 1);
-        if (pos) {
-          // Compress the HTML for writing patch information.
-          std::string html((char*)begin, size);
-          compression_html(html);
-
-          // RemoveUpdateError
-          // if (IsNeedPortable())
-          {
-            ReplaceStringInPlace(html, R"(hidden="[[!showUpdateStatus_]]")",
-                                 R"(hidden="true")");
-            ReplaceStringInPlace(
-                html, R"(hidden="[[!shouldShowIcons_(showUpdateStatus_)]]")",
-                R"(hidden="true")");
-          }
-
-          const char prouct_title[] = u8R"({aboutBrowserVersion}</div><div class="secondary"><a target="_blank" href="https://github.com/Bush2021/chrome_plus">Chrome++</a> )" RELEASE_VER_STR u8R"( modified version</div>)";
-          ReplaceStringInPlace(html, R"({aboutBrowserVersion}</div>)",
-                               prouct_title);
-
-          if (html.length() <= size) {
-            // Write modifications.
-            memcpy(begin, html.c_str(), html.length());
-
-            // Modify length.
-            new_len = html.length();
-            changed = true;
-          }
-        }
+  CloseHandle(file);
+  return INVALID_HANDLE_VALUE;
+}
+
+// Write to a temporary file and move it in place, so a crash or another
+// process never sees a half written cache. See WritePakCache.
+void SavePakCache(const std::wstring& path,
+                  const PakKey& key,
+                  const uint8_t* pristine,
+                  size_t size,
+                  const std::vector<PakPatchedSlot>& slots) {
+  std::wstring temp_path = path + L".tmp";
+  HANDLE file = RawCreateFile(temp_path.c_str(), GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    DebugLog(L"Create pak cache failed %d", GetLastError());
+    return;
+  }
 
-        return changed;
+  bool written = WritePakCache(
+      pristine, size, slots, key, [&](const void* data, size_t length) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        while (length) {
+          DWORD chunk = (DWORD)(std::min)(length, (size_t)(64 * 1024 * 1024));
+          DWORD done = 0;
+          if (!WriteFile(file, bytes, chunk, &done, nullptr) || done != chunk)
+            return false;
+          bytes += chunk;
+          length -= chunk;
+        }
+        return true;
       });
-    }
+  CloseHandle(file);
 
-    return buffer;
+  if (!written ||
+      !MoveFileExW(temp_path.c_str(), path.c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    DebugLog(L"Save pak cache failed %d", GetLastError());
+    DeleteFileW(temp_path.c_str());
   }
+}
 
-  return RawMapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh,
-                          dwFileOffsetLow, dwNumberOfBytesToMap);
+bool ContainsId(const std::vector<uint16_t>& ids, uint16_t id) {
+  return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+// A target pak Chrome has opened. It is patched on its own thread from the
+// moment it is opened, into a private copy-on-write view that is handed to
+// Chrome in place of the view it maps, so several paks are patched at once
+// and each map only waits for its own file.
+struct PakOpen {
+  PakTarget* target;
+  std::wstring path;
+  HANDLE file;
+  // Chrome's mapping of |file|, once created.
+  HANDLE map;
+  uint8_t* view;
+  size_t size;
+  PakKey key;
+  // Signaled once |patched| is filled in.
+  HANDLE done;
+  std::vector<uint16_t> patched;
+};
+
+// Everything below is shared by the threads that open files, under
+// pak_mutex.
+std::mutex pak_mutex;
+std::vector<std::unique_ptr<PakOpen>> pak_opens;
+// The rewriters built so far, by lower case path. A file opened again is
+// patched again with the same rewriter.
+std::vector<std::unique_ptr<PakTarget>> pak_targets;
+// The patterns without a '*' that no opened file has matched yet.
+std::vector<std::wstring> pak_patterns_left;
+// Paks being patched. The arena pool is trimmed when the last one is done.
+size_t pak_patching = 0;
+
+// The target of |path|, built on first use, or nullptr when no rule is for
+// it. Under pak_mutex.
+PakTarget* GetPakTarget(const std::wstring& path) {
+  for (auto& target : pak_targets) {
+    if (target->path == path)
+      return target.get();
+  }
+  if (!pak_rules.Matches(path))
+    return nullptr;
+  pak_targets.emplace_back(new PakTarget);
+  PakTarget* target = pak_targets.back().get();
+  target->path = path;
+  pak_rules.BuildRewriter(path, target->rewriter);
+  return target;
+}
+
+// Attach or detach one hook.
+void SetPakHook(PVOID* raw, PVOID hook, bool attach, const wchar_t* name) {
+  DetourTransactionBegin();
+  DetourUpdateThread(GetCurrentThread());
+  if (attach) {
+    DetourAttach(raw, hook);
+  } else {
+    DetourDetach(raw, hook);
+  }
+  auto status = DetourTransactionCommit();
+  if (status != NO_ERROR) {
+    DebugLog(L"%s %s failed %d", attach ? L"Hook" : L"Unhook", name, status);
+  }
+}
+
+void PatchPakFile(PakOpen& open, const uint8_t* pristine) {
+  const PakRewriter& rewriter = open.target->rewriter;
+  auto select = [&](uint16_t id) { return rewriter.Select(id); };
+  auto rewrite = [&](uint16_t id, uint8_t* data, uint32_t size,
+                     uint32_t& new_len, MinifyMode& squeeze) {
+    return rewriter.Rewrite(id, data, size, new_len, squeeze);
+  };
+
+  const PakKey& key = open.key;
+  if (key.tables_hash == 0) {
+    open.patched = TraversalGZIPResources(open.view, open.size, select,
+                                          rewriter.triggers(), rewrite, 0,
+                                          pristine);
+    return;
+  }
+
+  // Only the remembered resources when the pak has not changed.
+  std::wstring hits_path = GetPakHitsPath(open.path);
+  std::vector<uint16_t> hits;
+  bool remembered = LoadPakHits(hits_path, key, hits);
+  std::vector<uint16_t> patched;
+  if (remembered) {
+    patched = TraversalGZIPResources(
+        open.view, open.size,
+        [&](uint16_t id) {
+          return ContainsId(hits, id) ? kPakPatch : kPakSkip;
+        },
+        rewriter.triggers(), rewrite, 0, pristine);
+  }
+
+  if (!remembered || patched != hits) {
+    if (remembered)
+      DebugLog(L"Remembered pak hits are stale %s", open.path.c_str());
+
+    // Full scan, skipping what has been patched above.
+    std::vector<uint16_t> rest = TraversalGZIPResources(
+        open.view, open.size,
+        [&](uint16_t id) {
+          return ContainsId(patched, id) ? kPakSkip : select(id);
+        },
+        rewriter.triggers(), rewrite, 0, pristine);
+    patched.insert(patched.end(), rest.begin(), rest.end());
+    std::sort(patched.begin(), patched.end());
+    SavePakHits(hits_path, key, patched);
+  }
+  open.patched = std::move(patched);
 }
 
 HANDLE WINAPI MyCreateFileMapping(_In_ HANDLE hFile,
@@ -87,34 +294,150 @@ HANDLE WINAPI MyCreateFileMapping(_In_ HANDLE hFile,
                                   _In_ DWORD dwMaximumSizeHigh,
                                   _In_ DWORD dwMaximumSizeLow,
                                   _In_opt_ LPCTSTR lpName) {
-  if (hFile == resources_pak_file) {
-    // Modify it to be modifiable.
-    resources_pak_map =
-        RawCreateFileMapping(hFile, lpAttributes, PAGE_WRITECOPY,
-                             dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
+  HANDLE map =
+      RawCreateFileMapping(hFile, lpAttributes, flProtect, dwMaximumSizeHigh,
+                           dwMaximumSizeLow, lpName);
+  if (map) {
+    std::lock_guard<std::mutex> lock(pak_mutex);
+    for (auto& open : pak_opens) {
+      if (open->file == hFile && !open->map) {
+        open->map = map;
+        break;
+      }
+    }
+  }
+  return map;
+}
 
+HANDLE WINAPI MyMapViewOfFile(_In_ HANDLE hFileMappingObject,
+                              _In_ DWORD dwDesiredAccess,
+                              _In_ DWORD dwFileOffsetHigh,
+                              _In_ DWORD dwFileOffsetLow,
+                              _In_ SIZE_T dwNumberOfBytesToMap) {
+  std::unique_ptr<PakOpen> open;
+  {
+    std::lock_guard<std::mutex> lock(pak_mutex);
+    for (auto it = pak_opens.begin(); it != pak_opens.end(); ++it) {
+      if ((*it)->map && (*it)->map == hFileMappingObject) {
+        open = std::move(*it);
+        pak_opens.erase(it);
+        break;
+      }
+    }
     // No more hook needed.
-    resources_pak_file = nullptr;
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourDetach((LPVOID*)&RawCreateFileMapping, MyCreateFileMapping);
-    auto status = DetourTransactionCommit();
-    if (status != NO_ERROR) {
-      DebugLog(L"Unhook RawCreateFileMapping failed %d", status);
+    if (open && pak_opens.empty()) {
+      SetPakHook((PVOID*)&RawCreateFileMapping, MyCreateFileMapping, false,
+                 L"RawCreateFileMapping");
+      SetPakHook((PVOID*)&RawMapViewOfFile, MyMapViewOfFile, false,
+                 L"RawMapViewOfFile");
+    }
+  }
+
+  if (open) {
+    WaitForSingleObject(open->done, INFINITE);
+    CloseHandle(open->done);
+
+    // The patched view stands for the whole file only. A zero length maps
+    // the rest of the file.
+    size_t mapped_size =
+        dwNumberOfBytesToMap ? dwNumberOfBytesToMap : open->size;
+    if (!dwFileOffsetHigh && !dwFileOffsetLow && mapped_size == open->size)
+      return open->view;
+    DebugLog(L"Pak mapped in part %s", open->path.c_str());
+    UnmapViewOfFile(open->view);
+  }
+
+  return RawMapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh,
+                          dwFileOffsetLow, dwNumberOfBytesToMap);
+}
+
+// Start patching |file|, or swap it for the sidecar cache if that is up to
+// date. Return the handle to give Chrome.
+HANDLE OpenPakTarget(PakTarget& target, const std::wstring& path, HANDLE file) {
+  HANDLE map =
+      RawCreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (!map) {
+    DebugLog(L"Map pak failed %s %d", path.c_str(), GetLastError());
+    return file;
+  }
+  const uint8_t* pristine =
+      (const uint8_t*)RawMapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+
+  std::unique_ptr<PakOpen> open(new PakOpen{&target, path, file});
+  if (!pristine || !GetPakKey(file, pristine, target.rewriter, open->key)) {
+    open->key = {};
+  } else {
+    HANDLE cache = OpenPakCache(path + kPakCacheSuffix, open->key);
+    if (cache != INVALID_HANDLE_VALUE) {
+      // Already patched.
+      UnmapViewOfFile(pristine);
+      CloseHandle(map);
+      CloseHandle(file);
+      return cache;
+    }
+  }
+
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size))
+    open->size = (size_t)size.QuadPart;
+  open->view = (uint8_t*)RawMapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+  open->done = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  CloseHandle(map);
+  if (!open->view || !open->size || !open->done) {
+    if (open->view)
+      UnmapViewOfFile(open->view);
+    if (open->done)
+      CloseHandle(open->done);
+    if (pristine)
+      UnmapViewOfFile(pristine);
+    return file;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pak_mutex);
+    ++pak_patching;
+  }
+  PakOpen* patching = open.get();
+  std::thread([patching, pristine]() {
+    PatchPakFile(*patching, pristine);
+    {
+      // Paks are patched at once and share the arenas, give them back only
+      // once the last one is done.
+      std::lock_guard<std::mutex> lock(pak_mutex);
+      if (--pak_patching == 0)
+        GetPakArenaPool().Trim();
     }
 
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourAttach((LPVOID*)&RawMapViewOfFile, MyMapViewOfFile);
-    status = DetourTransactionCommit();
-    if (status != NO_ERROR) {
-      DebugLog(L"Hook RawMapViewOfFile failed %d", status);
+    // Chrome may write to or unmap the view once |done| is signaled, and
+    // |patching| is freed. Only the patched slots are copied before, the
+    // cache is written from them and the pristine view off the startup
+    // path.
+    std::wstring cache_path = patching->path + kPakCacheSuffix;
+    PakKey key = patching->key;
+    bool save = pristine && !patching->patched.empty() &&
+                patching->size == key.size;
+    std::vector<PakPatchedSlot> slots;
+    if (save) {
+      slots = CopyPatchedSlots(patching->view, patching->size,
+                               patching->patched);
     }
+    SetEvent(patching->done);
+
+    if (save)
+      SavePakCache(cache_path, key, pristine, (size_t)key.size, slots);
+    if (pristine)
+      UnmapViewOfFile(pristine);
+  }).detach();
 
-    return resources_pak_map;
+  std::lock_guard<std::mutex> lock(pak_mutex);
+  pak_opens.push_back(std::move(open));
+  if (pak_opens.size() == 1) {
+    SetPakHook((PVOID*)&RawCreateFileMapping, MyCreateFileMapping, true,
+               L"RawCreateFileMapping");
+    SetPakHook((PVOID*)&RawMapViewOfFile, MyMapViewOfFile, true,
+               L"RawMapViewOfFile");
   }
-  return RawCreateFileMapping(hFile, lpAttributes, flProtect, dwMaximumSizeHigh,
-                              dwMaximumSizeLow, lpName);
+  return file;
 }
 
 HANDLE WINAPI MyCreateFile(_In_ LPCTSTR lpFileName,
@@ -127,40 +450,43 @@ HANDLE WINAPI MyCreateFile(_In_ LPCTSTR lpFileName,
   HANDLE file = RawCreateFile(lpFileName, dwDesiredAccess, dwShareMode,
                               lpSecurityAttributes, dwCreationDisposition,
                               dwFlagsAndAttributes, hTemplateFile);
+  if (file == INVALID_HANDLE_VALUE || !isEndWith(lpFileName, L".pak"))
+    return file;
 
-  if (isEndWith(lpFileName, L"resources.pak")) {
-    resources_pak_file = file;
-    resources_pak_size = GetFileSize(resources_pak_file, nullptr);
-
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourAttach((LPVOID*)&RawCreateFileMapping, MyCreateFileMapping);
-    auto status = DetourTransactionCommit();
-    if (status != NO_ERROR) {
-      DebugLog(L"Hook RawCreateFileMapping failed %d", status);
+  PakTarget* target = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(pak_mutex);
+    std::wstring path = lpFileName;
+    for (auto& c : path) {
+      c = c == L'/' ? L'\\' : (wchar_t)towlower(c);
     }
+    target = GetPakTarget(path);
+    if (!target)
+      return file;
 
-    // No more hook needed.
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourDetach((LPVOID*)&RawCreateFile, MyCreateFile);
-    status = DetourTransactionCommit();
-    if (status != NO_ERROR) {
-      DebugLog(L"Unhook RawCreateFile failed %d", status);
-    }
+    // No more hook needed once every plain pattern has been seen. With a
+    // wildcard pattern, or a plain one Chrome never opens, the hook
+    // intentionally stays attached for the rest of the process, at the cost
+    // of a suffix compare per CreateFileW.
+    size_t left = pak_patterns_left.size();
+    pak_patterns_left.erase(
+        std::remove_if(pak_patterns_left.begin(), pak_patterns_left.end(),
+                       [&](const std::wstring& pattern) {
+                         return MatchPakFile(pattern, path);
+                       }),
+        pak_patterns_left.end());
+    if (left && pak_patterns_left.empty() && !pak_rules.HasWildcard())
+      SetPakHook((PVOID*)&RawCreateFile, MyCreateFile, false,
+                 L"RawCreateFile");
   }
 
-  return file;
+  return OpenPakTarget(*target, lpFileName, file);
 }
 
 void PakPatch() {
-  DetourTransactionBegin();
-  DetourUpdateThread(GetCurrentThread());
-  DetourAttach((LPVOID*)&RawCreateFile, MyCreateFile);
-  auto status = DetourTransactionCommit();
-  if (status != NO_ERROR) {
-    DebugLog(L"Hook RawCreateFile failed %d", status);
-  }
+  ReadPakRules();
+  pak_patterns_left = pak_rules.GetNamedPatterns();
+  SetPakHook((PVOID*)&RawCreateFile, MyCreateFile, true, L"RawCreateFile");
 }
 
 #endif  // PAKPATCH_H_
@@ -0,0 +1,523 @@
+#ifndef PAKRULES_H_
+#define PAKRULES_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "fastsearch.h"
+#include "htmlminify.h"
+#include "inifile.h"
+#include "multisearch.h"
+#include "stringsplit.h"
+#include "version.h"
+
+// What the traversal does with a resource before it is inflated in full.
+enum PakSelect {
+  kPakSkip,
+  kPakScan,   // Only if one of the triggers shows up in the stream.
+  kPakPatch,  // Always.
+};
+
+// The pak file rules apply to when they do not name one.
+const char kPakDefaultFile[] = "resources.pak";
+
+// Whether |path| is the pak file named by |pattern|, like "resources.pak"
+// or "locales/*.pak". The pattern matches the last components of the path,
+// case insensitively and with either slash, and a '*' matches any part of
+// one component.
+template <typename Char>
+bool MatchPakFile(const std::basic_string<Char>& pattern,
+                  const std::basic_string<Char>& path) {
+  auto fold = [](Char c) -> Char {
+    if (c == '/')
+      return '\\';
+    return c >= 'A' && c <= 'Z' ? (Char)(c - 'A' + 'a') : c;
+  };
+
+  // Where the path has as many components as the pattern.
+  size_t components = 1;
+  for (Char c : pattern) {
+    components += fold(c) == '\\';
+  }
+  size_t start = path.size();
+  while (components && start > 0) {
+    if (fold(path[start - 1]) == '\\' && --components == 0)
+      break;
+    --start;
+  }
+  if (components > 1)
+    return false;
+
+  // Glob with '*' only, backtracking to the last star.
+  size_t p = 0, t = start, star = std::basic_string<Char>::npos, mark = 0;
+  while (t < path.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      mark = t;
+    } else if (p < pattern.size() && fold(pattern[p]) == fold(path[t])) {
+      ++p;
+      ++t;
+    } else if (star != std::basic_string<Char>::npos &&
+               fold(path[mark]) != '\\') {
+      p = star + 1;
+      t = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*')
+    ++p;
+  return p == pattern.size();
+}
+
+// A declarative resource patch. The rule applies to a resource when its id
+// is in |ids| (if any are given) and |needle| occurs in it (if one is
+// given). Every search string of an applied rule is then replaced.
+struct PakRule {
+  std::vector<uint16_t> ids;
+  std::string needle;
+  MinifyMode minify = kMinifyNone;
+  std::vector<std::pair<std::string, std::string>> replacements;
+};
+
+// The minify value of a rule file: "html", "collapse", or a number that
+// trims the lines when it is not 0.
+MinifyMode ParseMinifyMode(const std::string& value) {
+  if (value == "html")
+    return kMinifyHtml;
+  if (value == "collapse")
+    return kMinifyCollapse;
+  return atoi(value.c_str()) != 0 ? kMinifyLines : kMinifyNone;
+}
+
+// The ids value of a rule file: resource ids separated by commas. Ids that
+// are 0 or do not fit 16 bits are ignored.
+template <typename Char>
+void ParsePakIds(std::basic_string_view<Char> value,
+                 std::vector<uint16_t>& ids) {
+  for (std::basic_string_view<Char> id :
+       StringTokens<Char>(value, Char(','), {})) {
+    size_t i = 0;
+    while (i < id.size() && (id[i] == ' ' || id[i] == '\t')) {
+      ++i;
+    }
+    unsigned long number = 0;
+    for (; i < id.size() && id[i] >= '0' && id[i] <= '9'; ++i) {
+      number = number * 10 + (id[i] - '0');
+      if (number > 0xFFFF)
+        break;
+    }
+    if (number > 0 && number <= 0xFFFF)
+      ids.push_back((uint16_t)number);
+  }
+}
+
+// All rules compiled into one multi-pattern automaton. A resource is
+// scanned once for the needles and search strings of every rule, and the
+// replacements are written in a single copy into a per-thread buffer that
+// is reused across resources.
+class PakRewriter {
+ public:
+  // False if the rule has nothing to select or nothing to do.
+  static bool IsValidRule(const PakRule& rule) {
+    if (rule.ids.empty() && rule.needle.empty())
+      return false;
+    if (rule.replacements.empty() && rule.minify == kMinifyNone)
+      return false;
+    // The only strings MultiSearcher::Add refuses.
+    for (const auto& replacement : rule.replacements) {
+      if (replacement.first.empty())
+        return false;
+    }
+    return true;
+  }
+
+  // Return false for a rule that is not valid, see IsValidRule.
+  bool AddRule(const PakRule& rule) {
+    if (!IsValidRule(rule))
+      return false;
+    rules_.push_back(rule);
+    compiled_ = false;
+    return true;
+  }
+
+  size_t size() const { return rules_.size(); }
+
+  // Build the automaton. Rewrite may then be called from several threads.
+  void Compile() {
+    searcher_ = MultiSearcher();
+    patterns_.clear();
+    triggers_.clear();
+    for (int rule = 0; rule < (int)rules_.size(); ++rule) {
+      const PakRule& r = rules_[rule];
+      if (!r.needle.empty()) {
+        AddPattern(r.needle, rule, -1);
+        triggers_.emplace_back((const uint8_t*)r.needle.data(),
+                               (int)r.needle.size());
+      }
+      for (int i = 0; i < (int)r.replacements.size(); ++i) {
+        AddPattern(r.replacements[i].first, rule, i);
+      }
+    }
+    // Scan builds the table on first use, do it before any thread does.
+    searcher_.Compile();
+    compiled_ = true;
+  }
+
+  // The needles, for the streaming pre-scan of the traversal.
+  const std::vector<Searcher>& triggers() const { return triggers_; }
+
+  PakSelect Select(uint16_t id) const {
+    PakSelect select = kPakSkip;
+    for (const PakRule& rule : rules_) {
+      if (!rule.ids.empty() &&
+          std::find(rule.ids.begin(), rule.ids.end(), id) == rule.ids.end())
+        continue;
+      if (rule.needle.empty())
+        return kPakPatch;
+      select = kPakScan;
+    }
+    return select;
+  }
+
+  // FNV-1a over every rule, changes whenever a rule does.
+  uint64_t Hash() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&](const void* data, size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+      }
+      hash = (hash ^ size) * 0x100000001B3ull;
+    };
+    for (const PakRule& rule : rules_) {
+      mix(rule.ids.data(), rule.ids.size() * sizeof(uint16_t));
+      mix(rule.needle.data(), rule.needle.size());
+      mix(&rule.minify, sizeof(rule.minify));
+      for (const auto& replacement : rule.replacements) {
+        mix(replacement.first.data(), replacement.first.size());
+        mix(replacement.second.data(), replacement.second.size());
+      }
+    }
+    return hash;
+  }
+
+  // Apply the rules that select resource |id| to [data, data + size). The
+  // resource is minified first, then the search strings are replaced in the
+  // minified text. The result is written back if it fits in |size| bytes,
+  // and its length is stored in |new_len|; |data| may be left minified when
+  // false is returned. |squeeze| is set to how much more the result may
+  // be minified to fit a slot: kMinifyHtml if any of the rules minifies,
+  // kMinifyNone otherwise.
+  bool Rewrite(uint16_t id,
+               uint8_t* data,
+               uint32_t size,
+               uint32_t& new_len,
+               MinifyMode& squeeze) const {
+    if (!compiled_ || rules_.empty())
+      return false;
+
+    thread_local std::vector<Match> matches;
+    thread_local std::vector<uint8_t> active;
+    thread_local std::vector<uint8_t> output;
+    auto scan = [&]() {
+      matches.clear();
+      searcher_.Scan(data, (int)size, [&](int pattern, const uint8_t* match) {
+        matches.push_back({(uint32_t)(match - data), pattern});
+      });
+    };
+    scan();
+
+    // Which rules apply.
+    active.assign(rules_.size(), 0);
+    for (int rule = 0; rule < (int)rules_.size(); ++rule) {
+      const std::vector<uint16_t>& ids = rules_[rule].ids;
+      active[rule] = ids.empty() || std::find(ids.begin(), ids.end(), id) !=
+                                        ids.end();
+      if (active[rule] && !rules_[rule].needle.empty()) {
+        active[rule] = std::any_of(
+            matches.begin(), matches.end(), [&](const Match& match) {
+              return patterns_[match.pattern].rule == rule &&
+                     patterns_[match.pattern].replacement < 0;
+            });
+      }
+    }
+    // The later mode in MinifyMode wins when several rules minify, which
+    // puts kMinifyHtml, the only one that leaves scripts alone, first.
+    MinifyMode minify = kMinifyNone;
+    bool any = false;
+    for (int rule = 0; rule < (int)rules_.size(); ++rule) {
+      any |= active[rule] != 0;
+      if (active[rule])
+        minify = (std::max)(minify, rules_[rule].minify);
+    }
+    if (!any)
+      return false;
+
+    // The needles decide on the text as it is, the search strings see it
+    // minified.
+    const uint32_t original_size = size;
+    if (minify != kMinifyNone) {
+      size = MinifyWhitespace(data, size, minify);
+      scan();
+    }
+
+    // Leftmost first, the longer search string on a tie, no overlaps.
+    matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                 [&](const Match& match) {
+                                   const Pattern& p = patterns_[match.pattern];
+                                   return p.replacement < 0 || !active[p.rule];
+                                 }),
+                  matches.end());
+    std::sort(matches.begin(), matches.end(),
+              [&](const Match& a, const Match& b) {
+                if (a.offset != b.offset)
+                  return a.offset < b.offset;
+                if (Search(a).size() != Search(b).size())
+                  return Search(a).size() > Search(b).size();
+                return a.pattern < b.pattern;
+              });
+
+    size_t output_size = size;
+    uint32_t cursor = 0;
+    size_t kept = 0;
+    for (const Match& match : matches) {
+      if (match.offset < cursor)
+        continue;
+      output_size += Replace(match).size() - Search(match).size();
+      cursor = match.offset + (uint32_t)Search(match).size();
+      matches[kept++] = match;
+    }
+    matches.resize(kept);
+    if (matches.empty() && size == original_size)
+      return false;
+
+    // One copy into the exact size.
+    output.resize(output_size);
+    uint8_t* out = output.data();
+    cursor = 0;
+    for (const Match& match : matches) {
+      memcpy(out, data + cursor, match.offset - cursor);
+      out += match.offset - cursor;
+      const std::string& replace = Replace(match);
+      memcpy(out, replace.data(), replace.size());
+      out += replace.size();
+      cursor = match.offset + (uint32_t)Search(match).size();
+    }
+    memcpy(out, data + cursor, size - cursor);
+    if (output_size > original_size)
+      return false;
+
+    memcpy(data, output.data(), output_size);
+    new_len = (uint32_t)output_size;
+    squeeze = minify != kMinifyNone ? kMinifyHtml : kMinifyNone;
+    return true;
+  }
+
+ private:
+  struct Pattern {
+    int rule;
+    int replacement;  // -1 for the needle.
+  };
+
+  struct Match {
+    uint32_t offset;
+    int pattern;
+  };
+
+  // AddRule has checked that every string is accepted, so the ids of the
+  // searcher and |patterns_| stay in step.
+  void AddPattern(const std::string& text, int rule, int replacement) {
+    int id = searcher_.Add((const uint8_t*)text.data(), (int)text.size());
+    assert(id == (int)patterns_.size());
+    (void)id;
+    patterns_.push_back({rule, replacement});
+  }
+
+  const std::string& Search(const Match& match) const {
+    const Pattern& p = patterns_[match.pattern];
+    return rules_[p.rule].replacements[p.replacement].first;
+  }
+
+  const std::string& Replace(const Match& match) const {
+    const Pattern& p = patterns_[match.pattern];
+    return rules_[p.rule].replacements[p.replacement].second;
+  }
+
+  std::vector<PakRule> rules_;
+  std::vector<Pattern> patterns_;
+  std::vector<Searcher> triggers_;
+  // Read only once compiled.
+  mutable MultiSearcher searcher_;
+  bool compiled_ = false;
+};
+
+// \n, \t and \\ stand for a newline, a tab and a backslash in rule files.
+std::string UnescapeRuleString(const std::string& text) {
+  std::string result;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '\\' && i + 1 < text.size()) {
+      char c = text[++i];
+      result += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+    } else {
+      result += text[i];
+    }
+  }
+  return result;
+}
+
+// Read a [pak_patch*] section of an INI file into |rule| and the pak file
+// pattern it is for, for example
+//
+//   [pak_patch.example]
+//   file=locales/*.pak
+//   ids=12345,12346
+//   needle=</settings-about-page>
+//   minify=1
+//   search1=hidden="[[!showUpdateStatus_]]"
+//   replace1=hidden="true"
+//
+// A rule needs ids, a needle or both, and search/replace pairs numbered
+// from 1. It applies to resources.pak unless a file is given. minify is 1
+// to trim the lines, collapse, or html; see MinifyMode. The resource is
+// minified before the search strings are looked for. Return false for
+// sections that are not pak rules.
+bool ReadPakRule(const IniFile::Section& section,
+                 PakRule& rule,
+                 std::string& file) {
+  if (section.name.compare(0, 9, "pak_patch") != 0)
+    return false;
+
+  ParsePakIds<char>(section.Get("ids"), rule.ids);
+  rule.needle = UnescapeRuleString(section.Get("needle"));
+  rule.minify = ParseMinifyMode(section.Get("minify"));
+  for (int i = 1;; ++i) {
+    std::string search = section.Get("search" + std::to_string(i));
+    if (search.empty())
+      break;
+    rule.replacements.emplace_back(
+        UnescapeRuleString(search),
+        UnescapeRuleString(section.Get("replace" + std::to_string(i))));
+  }
+
+  file = section.Get("file");
+  if (file.empty())
+    file = kPakDefaultFile;
+  return true;
+}
+
+// Add the Chrome++ version to the about page and hide the update error.
+PakRule GetBuiltinPakRule() {
+  PakRule about;
+  about.needle = R"(</settings-about-page>)";
+  about.minify = kMinifyLines;
+
+  // RemoveUpdateError
+  // if (IsNeedPortable())
+  {
+    about.replacements.emplace_back(R"(hidden="[[!showUpdateStatus_]]")",
+                                    R"(hidden="true")");
+    about.replacements.emplace_back(
+        R"(hidden="[[!shouldShowIcons_(showUpdateStatus_)]]")",
+        R"(hidden="true")");
+  }
+
+  const char prouct_title[] = u8R"({aboutBrowserVersion}</div><div class="secondary"><a target="_blank" href="https://github.com/Bush2021/chrome_plus">Chrome++</a> )" RELEASE_VER_STR u8R"( modified version</div>)";
+  about.replacements.emplace_back(R"({aboutBrowserVersion}</div>)",
+                                  prouct_title);
+  return about;
+}
+
+// Every pak rule with the file pattern it is for, in the order they are
+// read: the built-in rule, then chrome++.ini, then chrome++.pakrules. A pak
+// file gets every rule whose pattern matches its path, in that order, so
+// the dll and pakutil build the same rewriter and rules hash for it.
+class PakRuleSet {
+ public:
+  void Add(const std::string& file, const PakRule& rule) {
+    std::wstring pattern = Utf8ToWide(file);
+    for (auto& c : pattern) {
+      c = c == L'/' ? L'\\' : c >= L'A' && c <= L'Z' ? c - L'A' + L'a' : c;
+    }
+    rules_.push_back({pattern, rule});
+  }
+
+  void AddBuiltinRules() { Add(kPakDefaultFile, GetBuiltinPakRule()); }
+
+  // Add the [pak_patch*] sections of |ini| in file order, see ReadPakRule.
+  // Return the names of those that are not valid rules.
+  std::vector<std::string> AddIniFile(const IniFile& ini) {
+    std::vector<std::string> invalid;
+    for (const IniFile::Section& section : ini.sections()) {
+      PakRule rule;
+      std::string file;
+      if (!ReadPakRule(section, rule, file))
+        continue;
+      if (PakRewriter::IsValidRule(rule)) {
+        Add(file, rule);
+      } else {
+        invalid.push_back(section.name);
+      }
+    }
+    return invalid;
+  }
+
+  bool Matches(const std::wstring& path) const {
+    for (const Entry& entry : rules_) {
+      if (MatchPakFile(entry.pattern, path))
+        return true;
+    }
+    return false;
+  }
+
+  // Add the rules of |path| to |rewriter| and compile it. Return false when
+  // no rule is for |path|.
+  bool BuildRewriter(const std::wstring& path, PakRewriter& rewriter) const {
+    bool any = false;
+    for (const Entry& entry : rules_) {
+      if (MatchPakFile(entry.pattern, path))
+        any |= rewriter.AddRule(entry.rule);
+    }
+    rewriter.Compile();
+    return any;
+  }
+
+  // The patterns without a '*', each once. Every file they name is known.
+  std::vector<std::wstring> GetNamedPatterns() const {
+    std::vector<std::wstring> patterns;
+    for (const Entry& entry : rules_) {
+      if (entry.pattern.find(L'*') == std::wstring::npos &&
+          std::find(patterns.begin(), patterns.end(), entry.pattern) ==
+              patterns.end())
+        patterns.push_back(entry.pattern);
+    }
+    return patterns;
+  }
+
+  // Whether a pattern with a '*' may still match any file opened later.
+  bool HasWildcard() const {
+    for (const Entry& entry : rules_) {
+      if (entry.pattern.find(L'*') != std::wstring::npos)
+        return true;
+    }
+    return false;
+  }
+
+ private:
+  struct Entry {
+    // Lower case, with backslashes.
+    std::wstring pattern;
+    PakRule rule;
+  };
+
+  std::vector<Entry> rules_;
+};
+
+#endif  // PAKRULES_H_
@@ -0,0 +1,155 @@
+#ifndef PARALLELSEARCH_H_
+#define PARALLELSEARCH_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "fastsearch.h"
+
+// Buffers smaller than this are searched on the calling thread, starting
+// threads would cost more than it saves.
+const int kParallelSearchMinSize = 8 * 1024 * 1024;
+
+// Work is handed out in blocks so that a match found early lets the other
+// workers stop after their current block.
+const int kParallelSearchBlockSize = 1024 * 1024;
+
+const unsigned kParallelSearchMaxThreads = 8;
+
+// Helper threads shared by every ParallelSearch call, so that a search does
+// not pay for starting threads. They are started on first use and then wait
+// for the next search. The pool is never destroyed and its threads are
+// detached, so nothing waits for them at process exit.
+class SearchThreadPool {
+ public:
+  static SearchThreadPool& Get() {
+    static SearchThreadPool* pool = new SearchThreadPool;
+    return *pool;
+  }
+
+  // Run |task| on the calling thread and on |helpers| pool threads at the
+  // same time, and return once all of them are done. Returns false without
+  // running anything when another search is using the pool.
+  bool Run(unsigned helpers, const std::function<void()>& task) {
+    std::unique_lock<std::mutex> busy(run_mutex_, std::try_to_lock);
+    if (!busy.owns_lock())
+      return false;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (; threads_ < helpers; ++threads_) {
+        std::thread(&SearchThreadPool::WorkerLoop, this).detach();
+      }
+      task_ = &task;
+      unclaimed_ = helpers;
+      running_ = helpers;
+      ++generation_;
+    }
+    wake_.notify_all();
+
+    task();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    task_ = nullptr;
+    return true;
+  }
+
+ private:
+  SearchThreadPool() = default;
+
+  void WorkerLoop() {
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      // Each search is claimed by at most |helpers| threads, once each.
+      wake_.wait(lock, [&] {
+        return unclaimed_ > 0 && generation_ != generation;
+      });
+      generation = generation_;
+      --unclaimed_;
+      const std::function<void()>& task = *task_;
+      lock.unlock();
+      task();
+      lock.lock();
+      if (--running_ == 0)
+        done_.notify_one();
+    }
+  }
+
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void()>* task_ = nullptr;
+  unsigned threads_ = 0;
+  unsigned unclaimed_ = 0;
+  unsigned running_ = 0;
+  uint64_t generation_ = 0;
+};
+
+// Same result as `FastSearch`, but large buffers are split into blocks that
+// overlap by m - 1 bytes and searched on several threads. Blocks are taken in
+// increasing order and a block that starts after the best match so far is
+// skipped, so the lowest-offset match is returned.
+const uint8_t* ParallelSearch(const uint8_t* s,
+                              int n,
+                              const uint8_t* p,
+                              int m,
+                              unsigned threads = 0) {
+  if (!s || !p || n < m)
+    return nullptr;
+
+  if (threads == 0) {
+    threads = (std::min)((std::max)(std::thread::hardware_concurrency(), 1u),
+                         kParallelSearchMaxThreads);
+  }
+  if (threads <= 1 || n < kParallelSearchMinSize || m == 0 ||
+      m > kParallelSearchBlockSize) {
+    return FastSearch(s, n, p, m);
+  }
+
+  // Every match starts at or before n - m.
+  const int block_count = (n - m) / kParallelSearchBlockSize + 1;
+  std::atomic<int> next_block(0);
+  std::atomic<int> best(n);
+
+  auto worker = [&]() {
+    while (true) {
+      int block = next_block.fetch_add(1);
+      if (block >= block_count)
+        return;
+
+      int start = block * kParallelSearchBlockSize;
+      if (start >= best.load(std::memory_order_relaxed))
+        return;
+
+      int length = (std::min)(kParallelSearchBlockSize + m - 1, n - start);
+      const uint8_t* match = FastSearch(s + start, length, p, m);
+      if (!match)
+        continue;
+
+      int offset = (int)(match - s);
+      int current = best.load();
+      while (offset < current &&
+             !best.compare_exchange_weak(current, offset)) {
+      }
+    }
+  };
+
+  // A concurrent search keeps the pool, this one then runs alone.
+  threads = std::min<unsigned>(threads, block_count);
+  if (!SearchThreadPool::Get().Run(threads - 1, worker))
+    worker();
+
+  int offset = best.load();
+  return offset < n ? s + offset : nullptr;
+}
+
+#endif  // PARALLELSEARCH_H_
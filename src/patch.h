@@ -26,12 +26,11 @@ pLdrLoadDll RawLdrLoadDll = nullptr;
 // void Outdated(HMODULE module) {
 //   // "OutdatedUpgradeBubble.Show"
 // #ifdef _WIN64
-//   BYTE search[] = {0x48, 0x89, 0x8C, 0x24, 0xF0, 0x00, 0x00, 0x00, 0x80,
-//   0x3D}; uint8_t* match = SearchModuleRaw(module, search, sizeof(search));
+//   static const Signature search("48 89 8C 24 ?? ?? 00 00 80 3D");
 // #else
-//   BYTE search[] = {0x31, 0xE8, 0x89, 0x45, 0xF0, 0x88, 0x5D, 0xEF, 0x80,
-//   0x3D}; uint8_t* match = SearchModuleRaw(module, search, sizeof(search));
+//   static const Signature search("31 E8 89 45 ?? 88 5D ?? 80 3D");
 // #endif
+//   uint8_t* match = SearchModuleRaw(module, search);
 //   if (match) {
 //     if (*(match + 0xF) == 0x74) {
 //       BYTE patch[] = {0x90, 0x90};
@@ -0,0 +1,78 @@
+#ifndef PEIMAGE_H_
+#define PEIMAGE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Minimal PE section lookup on a raw byte buffer. It only depends on the
+// on-disk layout, so it works on a loaded module as well as on a chrome.dll
+// read into memory on any platform.
+struct PeSection {
+  uint8_t* data;
+  int size;
+};
+
+static uint32_t PeRead32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint16_t PeRead16(const uint8_t* p) {
+  uint16_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Find a section by name, like ".text" or ".rdata". |image_size| is used for
+// bounds checks, pass 0 when the buffer is a module mapped by the loader.
+bool FindPeSection(uint8_t* image,
+                   size_t image_size,
+                   const char* name,
+                   PeSection& section) {
+  const size_t kDosHeaderSize = 64;
+  const size_t kFileHeaderSize = 20;
+  const size_t kSectionHeaderSize = 40;
+
+  auto in_bounds = [=](size_t offset, size_t length) {
+    return image_size == 0 ||
+           (offset <= image_size && length <= image_size - offset);
+  };
+
+  if (!image || !in_bounds(0, kDosHeaderSize) || PeRead16(image) != 0x5A4D)
+    return false;
+
+  size_t nt_offset = PeRead32(image + 0x3C);
+  if (!in_bounds(nt_offset, 4 + kFileHeaderSize) ||
+      PeRead32(image + nt_offset) != 0x00004550)
+    return false;
+
+  const uint8_t* file_header = image + nt_offset + 4;
+  uint16_t number_of_sections = PeRead16(file_header + 2);
+  uint16_t size_of_optional_header = PeRead16(file_header + 16);
+
+  size_t section_offset =
+      nt_offset + 4 + kFileHeaderSize + size_of_optional_header;
+  if (!in_bounds(section_offset,
+                 (size_t)number_of_sections * kSectionHeaderSize))
+    return false;
+
+  for (int i = 0; i < number_of_sections; ++i) {
+    const uint8_t* header = image + section_offset + i * kSectionHeaderSize;
+    if (strncmp((const char*)header, name, 8) != 0)
+      continue;
+
+    uint32_t size_of_raw_data = PeRead32(header + 16);
+    uint32_t pointer_to_raw_data = PeRead32(header + 20);
+    if (!in_bounds(pointer_to_raw_data, size_of_raw_data) ||
+        size_of_raw_data > INT32_MAX)
+      return false;
+
+    section.data = image + pointer_to_raw_data;
+    section.size = (int)size_of_raw_data;
+    return true;
+  }
+  return false;
+}
+
+#endif  // PEIMAGE_H_
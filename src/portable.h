@@ -44,7 +44,7 @@ std::wstring GetCommand(LPWSTR param) {
       // Repeat the above process until the -- sign no longer exists in the
       // string
       {
-        auto cr_command_line = GetCrCommandLine();
+        auto cr_command_line = GetConfig().command_line;
         std::wstring temp = cr_command_line;
         while (true) {
           auto pos = temp.find(L"--");
@@ -84,17 +84,12 @@ bool IsFirstRun() {
 void LaunchCommands(const std::wstring& get_commands,
                     int show_command,
                     std::vector<HANDLE>* program_handles) {
-  auto commands = StringSplit(
-      get_commands, L';',
-      L"");  // Quotes should not be used as they can cause errors with paths
-             // that contain spaces. Since semicolons rarely appear in names and
-             // commands, they are used as delimiters.
-  if (commands.empty()) {
-    return;
-  }
-  for (const auto& command : commands) {
-    std::wstring expanded_path = ExpandEnvironmentPath(command);
-    ReplaceStringInPlace(expanded_path, L"%app%", GetAppDir());
+  // Quotes should not be used as they can cause errors with paths that
+  // contain spaces. Since semicolons rarely appear in names and commands, they
+  // are used as delimiters.
+  for (std::wstring_view command : StringSplit(get_commands, L';')) {
+    std::wstring expanded_path = ExpandEnvironmentPath(std::wstring(command));
+    ReplaceAll(expanded_path, {{L"%app%", GetAppDir()}});
     HANDLE handle = RunExecute(expanded_path.c_str(), show_command);
     if (program_handles != nullptr && handle != nullptr) {
       program_handles->push_back(handle);
@@ -103,7 +98,7 @@ void LaunchCommands(const std::wstring& get_commands,
 }
 
 void KillLaunchOnExit(std::vector<HANDLE>* program_handles) {
-  if (IsKillLaunchOnExit() && program_handles != nullptr) {
+  if (GetConfig().kill_launch_on_exit && program_handles != nullptr) {
     for (auto handle : *program_handles) {
       TerminateProcess(handle, 0);
     }
@@ -112,8 +107,8 @@ void KillLaunchOnExit(std::vector<HANDLE>* program_handles) {
 
 void Portable(LPWSTR param) {
   bool first_run = IsFirstRun();
-  auto launch_on_startup = GetLaunchOnStartup();
-  auto launch_on_exit = GetLaunchOnExit();
+  auto launch_on_startup = GetConfig().launch_on_startup;
+  auto launch_on_exit = GetConfig().launch_on_exit;
   std::vector<HANDLE> program_handles = {nullptr};
 
   if (first_run && !launch_on_startup.empty()) {
@@ -0,0 +1,151 @@
+#ifndef SIGNATURE_H_
+#define SIGNATURE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "fastsearch.h"
+
+// A byte signature with wildcards in IDA notation, e.g.
+// "48 89 8C 24 ?? ?? 00 00 80 3D". One signature can match several builds
+// whose code only differs in displacements or immediates.
+class Signature {
+ public:
+  explicit Signature(const char* pattern) { Parse(pattern); }
+
+  // An exact byte string without wildcards.
+  Signature(const uint8_t* bytes, int length)
+      : bytes_(bytes, bytes + length),
+        mask_(length, 0xFF),
+        anchor_length_(length) {}
+
+  bool IsValid() const { return !bytes_.empty(); }
+  int size() const { return (int)bytes_.size(); }
+
+  // The longest run without wildcards, used to locate candidates.
+  const uint8_t* anchor() const { return bytes_.data() + anchor_offset_; }
+  int anchor_offset() const { return anchor_offset_; }
+  int anchor_length() const { return anchor_length_; }
+
+  // Return the leftmost match in [s, s + n), or nullptr.
+  const uint8_t* Search(const uint8_t* s, int n) const {
+    if (!s || !IsValid() || n < size())
+      return nullptr;
+
+    if (anchor_length_ == 0)
+      return s;
+
+    // The anchor (the longest run without wildcards) is found with the
+    // SIMD `FastSearch`, only its hits are checked against the full mask.
+    const uint8_t* cursor = s + anchor_offset_;
+    const uint8_t* end = s + n - size() + anchor_offset_ + anchor_length_;
+    while (cursor < end) {
+      const uint8_t* hit =
+          FastSearch(cursor, (int)(end - cursor), anchor(), anchor_length_);
+      if (!hit)
+        break;
+
+      const uint8_t* candidate = hit - anchor_offset_;
+      if (MatchAt(candidate))
+        return candidate;
+      cursor = hit + 1;
+    }
+    return nullptr;
+  }
+
+  uint8_t* Search(uint8_t* s, int n) const {
+    return (uint8_t*)Search((const uint8_t*)s, n);
+  }
+
+  // Check the signature at |p|, which must have size() readable bytes.
+  bool MatchAt(const uint8_t* p) const {
+    int i = 0;
+#ifdef FASTSEARCH_X86
+    for (; i + 16 <= size(); i += 16) {
+      __m128i data = _mm_loadu_si128((const __m128i*)(p + i));
+      __m128i bytes = _mm_loadu_si128((const __m128i*)(bytes_.data() + i));
+      __m128i mask = _mm_loadu_si128((const __m128i*)(mask_.data() + i));
+      __m128i diff = _mm_and_si128(_mm_xor_si128(data, bytes), mask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) !=
+          0xFFFF)
+        return false;
+    }
+#endif
+    for (; i < size(); ++i) {
+      if ((p[i] ^ bytes_[i]) & mask_[i])
+        return false;
+    }
+    return true;
+  }
+
+ private:
+  static int HexValue(char c) {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  // Tokens are separated by spaces, "?" or "??" is a wildcard byte. A
+  // malformed pattern leaves the signature empty.
+  void Parse(const char* pattern) {
+    const char* p = pattern;
+    while (p && *p) {
+      if (*p == ' ') {
+        ++p;
+        continue;
+      }
+
+      if (*p == '?') {
+        ++p;
+        if (*p == '?')
+          ++p;
+        bytes_.push_back(0);
+        mask_.push_back(0);
+      } else {
+        int high = HexValue(p[0]);
+        int low = high < 0 ? -1 : HexValue(p[1]);
+        if (low < 0) {
+          bytes_.clear();
+          mask_.clear();
+          return;
+        }
+        bytes_.push_back((uint8_t)(high << 4 | low));
+        mask_.push_back(0xFF);
+        p += 2;
+      }
+
+      if (*p && *p != ' ') {
+        bytes_.clear();
+        mask_.clear();
+        return;
+      }
+    }
+
+    // Anchor on the longest run of fixed bytes.
+    int run_start = 0;
+    for (int i = 0; i <= size(); ++i) {
+      if (i < size() && mask_[i]) {
+        continue;
+      }
+      if (i - run_start > anchor_length_) {
+        anchor_offset_ = run_start;
+        anchor_length_ = i - run_start;
+      }
+      run_start = i + 1;
+    }
+  }
+
+  std::vector<uint8_t> bytes_;
+  std::vector<uint8_t> mask_;
+  int anchor_offset_ = 0;
+  int anchor_length_ = 0;
+};
+
+#endif  // SIGNATURE_H_
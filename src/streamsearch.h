@@ -0,0 +1,98 @@
+#ifndef STREAMSEARCH_H_
+#define STREAMSEARCH_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fastsearch.h"
+
+// Search a needle in data that arrives in successive chunks, e.g. the output
+// windows of an inflate stream. The last m - 1 bytes are carried over so a
+// match that straddles two chunks is still found, and every match is
+// reported with its offset from the start of the stream.
+class StreamSearcher {
+ public:
+  StreamSearcher(const uint8_t* p, int m) : pattern_(p, p + m) {}
+
+  // Start a new stream.
+  void Reset() {
+    tail_.clear();
+    offset_ = 0;
+    stopped_ = false;
+  }
+
+  // Total number of bytes fed since the last reset.
+  uint64_t offset() const { return offset_; }
+
+  bool stopped() const { return stopped_; }
+
+  // Feed the next chunk. f(offset) is called for every match in stream
+  // order; returning false from it stops the search, and so does every later
+  // Feed call. Return false once the search is stopped.
+  template <typename Function>
+  bool Feed(const uint8_t* chunk, int n, Function f) {
+    if (stopped_)
+      return false;
+
+    const int m = (int)pattern_.size();
+    if (m == 0 || n <= 0) {
+      offset_ += n > 0 ? n : 0;
+      return true;
+    }
+
+    // Matches that start in the carried tail and end in this chunk.
+    if (!tail_.empty()) {
+      const int tail_size = (int)tail_.size();
+      joined_.assign(tail_.begin(), tail_.end());
+      joined_.insert(joined_.end(), chunk, chunk + (std::min)(n, m - 1));
+
+      const uint8_t* begin = joined_.data();
+      const uint8_t* end = begin + joined_.size();
+      const uint8_t* cursor = begin;
+      while (const uint8_t* match =
+                 FastSearch(cursor, (int)(end - cursor), pattern_.data(), m)) {
+        if (match - begin >= tail_size)
+          break;
+        if (!f(offset_ - tail_size + (match - begin)))
+          return Stop();
+        cursor = match + 1;
+      }
+    }
+
+    // Matches inside the chunk.
+    const uint8_t* cursor = chunk;
+    while (const uint8_t* match = FastSearch(
+               cursor, (int)(chunk + n - cursor), pattern_.data(), m)) {
+      if (!f(offset_ + (match - chunk)))
+        return Stop();
+      cursor = match + 1;
+    }
+
+    // Keep the last m - 1 bytes of the stream.
+    if (n >= m - 1) {
+      tail_.assign(chunk + n - (m - 1), chunk + n);
+    } else {
+      tail_.insert(tail_.end(), chunk, chunk + n);
+      if ((int)tail_.size() > m - 1)
+        tail_.erase(tail_.begin(), tail_.end() - (m - 1));
+    }
+    offset_ += n;
+    return true;
+  }
+
+ private:
+  bool Stop() {
+    stopped_ = true;
+    return false;
+  }
+
+  std::vector<uint8_t> pattern_;
+  std::vector<uint8_t> tail_;
+  std::vector<uint8_t> joined_;
+  uint64_t offset_ = 0;
+  bool stopped_ = false;
+};
+
+#endif  // STREAMSEARCH_H_
@@ -0,0 +1,214 @@
+#ifndef STRINGREPLACE_H_
+#define STRINGREPLACE_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A search string and what replaces it.
+template <typename Char>
+using ReplacePair =
+    std::pair<std::basic_string_view<Char>, std::basic_string_view<Char>>;
+
+// Call f(offset, pair) for every match of |pairs| in |subject|, in order:
+// the leftmost match first, the longer search string on a tie, and the
+// search restarts after the end of each match, so replacements are never
+// searched again. Each search string is looked up again only once the
+// cursor passes its last known match.
+template <typename Char, typename Function>
+void ForEachReplacement(std::basic_string_view<Char> subject,
+                        const ReplacePair<Char>* pairs,
+                        size_t count,
+                        Function f) {
+  const size_t npos = std::basic_string_view<Char>::npos;
+  size_t inline_next[16];
+  std::vector<size_t> heap_next;
+  size_t* next = inline_next;
+  if (count > 16) {
+    heap_next.resize(count);
+    next = heap_next.data();
+  }
+  for (size_t i = 0; i < count; ++i) {
+    next[i] = pairs[i].first.empty() ? npos : subject.find(pairs[i].first);
+  }
+
+  size_t pos = 0;
+  while (true) {
+    size_t best = count;
+    for (size_t i = 0; i < count; ++i) {
+      if (next[i] != npos && next[i] < pos)
+        next[i] = subject.find(pairs[i].first, pos);
+      if (next[i] == npos)
+        continue;
+      if (best == count || next[i] < next[best] ||
+          (next[i] == next[best] &&
+           pairs[i].first.size() > pairs[best].first.size()))
+        best = i;
+    }
+    if (best == count)
+      return;
+    f(next[best], pairs[best]);
+    pos = next[best] + pairs[best].first.size();
+  }
+}
+
+// What the size pass found. The first matches are kept so that the write
+// pass only searches again when there were more than fit.
+struct ReplacePlan {
+  static const size_t kKept = 64;
+  size_t size = 0;
+  size_t matches = 0;
+  size_t offsets[kKept];
+  size_t pairs[kKept];
+};
+
+template <typename Char>
+void PlanReplacements(std::basic_string_view<Char> subject,
+                      const ReplacePair<Char>* pairs,
+                      size_t count,
+                      ReplacePlan& plan) {
+  plan.size = subject.size();
+  plan.matches = 0;
+  ForEachReplacement(subject, pairs, count,
+                     [&](size_t offset, const ReplacePair<Char>& pair) {
+                       plan.size += pair.second.size();
+                       plan.size -= pair.first.size();
+                       if (plan.matches < ReplacePlan::kKept) {
+                         plan.offsets[plan.matches] = offset;
+                         plan.pairs[plan.matches] = &pair - pairs;
+                       }
+                       ++plan.matches;
+                     });
+}
+
+// Size of |subject| once every pair is replaced.
+template <typename Char>
+size_t ReplaceAllSize(std::basic_string_view<Char> subject,
+                      const ReplacePair<Char>* pairs,
+                      size_t count,
+                      size_t* matches = nullptr) {
+  ReplacePlan plan;
+  PlanReplacements(subject, pairs, count, plan);
+  if (matches)
+    *matches = plan.matches;
+  return plan.size;
+}
+
+// Write |subject| with every pair replaced into |out|, which must hold
+// plan.size characters. |out| may be |subject| itself as long as the output
+// never gets ahead of the input.
+template <typename Char>
+void WriteReplacements(std::basic_string_view<Char> subject,
+                       const ReplacePair<Char>* pairs,
+                       size_t count,
+                       const ReplacePlan& plan,
+                       Char* out) {
+  size_t cursor = 0;
+  auto emit = [&](size_t offset, const ReplacePair<Char>& pair) {
+    memmove(out, subject.data() + cursor, (offset - cursor) * sizeof(Char));
+    out += offset - cursor;
+    memcpy(out, pair.second.data(), pair.second.size() * sizeof(Char));
+    out += pair.second.size();
+    cursor = offset + pair.first.size();
+  };
+  if (plan.matches <= ReplacePlan::kKept) {
+    for (size_t i = 0; i < plan.matches; ++i) {
+      emit(plan.offsets[i], pairs[plan.pairs[i]]);
+    }
+  } else {
+    ForEachReplacement(subject, pairs, count, emit);
+  }
+  memmove(out, subject.data() + cursor,
+          (subject.size() - cursor) * sizeof(Char));
+}
+
+// Replace every pair into a caller buffer in one forward pass. Return the
+// size of the result; nothing is written when it is larger than |out_size|.
+template <typename Char>
+size_t ReplaceAll(std::basic_string_view<Char> subject,
+                  const ReplacePair<Char>* pairs,
+                  size_t count,
+                  Char* out,
+                  size_t out_size) {
+  ReplacePlan plan;
+  PlanReplacements(subject, pairs, count, plan);
+  if (plan.size <= out_size)
+    WriteReplacements(subject, pairs, count, plan, out);
+  return plan.size;
+}
+
+// Replace every pair in |subject|, in place when the output never
+// overtakes the input: forward when it never gets ahead of it, backward
+// after one resize when it never falls behind. Otherwise the result is built
+// in one allocation of the exact size. Return whether anything matched.
+template <typename Char>
+bool ReplaceAll(std::basic_string<Char>& subject,
+                const ReplacePair<Char>* pairs,
+                size_t count) {
+  ReplacePlan plan;
+  PlanReplacements(std::basic_string_view<Char>(subject), pairs, count, plan);
+  if (plan.matches == 0)
+    return false;
+
+  // How far the output is ahead of the input after each match.
+  bool forward = true;
+  bool backward = plan.matches <= ReplacePlan::kKept;
+  if (backward) {
+    ptrdiff_t ahead = 0;
+    for (size_t i = 0; i < plan.matches; ++i) {
+      const ReplacePair<Char>& pair = pairs[plan.pairs[i]];
+      ahead += (ptrdiff_t)pair.second.size() - (ptrdiff_t)pair.first.size();
+      forward &= ahead <= 0;
+      backward &= ahead >= 0;
+    }
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      forward &= pairs[i].second.size() <= pairs[i].first.size();
+    }
+  }
+
+  if (forward) {
+    WriteReplacements(std::basic_string_view<Char>(subject), pairs, count,
+                      plan, &subject[0]);
+    subject.resize(plan.size);
+  } else if (backward) {
+    size_t in_end = subject.size();
+    size_t out_end = plan.size;
+    subject.resize(plan.size);
+    Char* data = &subject[0];
+    for (size_t i = plan.matches; i-- > 0;) {
+      const ReplacePair<Char>& pair = pairs[plan.pairs[i]];
+      size_t match_end = plan.offsets[i] + pair.first.size();
+      out_end -= in_end - match_end;
+      memmove(data + out_end, data + match_end,
+              (in_end - match_end) * sizeof(Char));
+      out_end -= pair.second.size();
+      memcpy(data + out_end, pair.second.data(),
+             pair.second.size() * sizeof(Char));
+      in_end = plan.offsets[i];
+    }
+  } else {
+    std::basic_string<Char> result(plan.size, Char());
+    WriteReplacements(std::basic_string_view<Char>(subject), pairs, count,
+                      plan, &result[0]);
+    subject.swap(result);
+  }
+  return true;
+}
+
+bool ReplaceAll(std::string& subject,
+                std::initializer_list<ReplacePair<char>> pairs) {
+  return ReplaceAll(subject, pairs.begin(), pairs.size());
+}
+
+bool ReplaceAll(std::wstring& subject,
+                std::initializer_list<ReplacePair<wchar_t>> pairs) {
+  return ReplaceAll(subject, pairs.begin(), pairs.size());
+}
+
+#endif  // STRINGREPLACE_H_
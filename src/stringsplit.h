@@ -0,0 +1,107 @@
+#ifndef STRINGSPLIT_H_
+#define STRINGSPLIT_H_
+
+#include <stddef.h>
+
+#include <iterator>
+#include <string_view>
+
+// The tokens of a string split at |delim|, produced lazily as views into
+// it, so the string must outlive the range. Empty tokens between two
+// delimiters are kept, a trailing delimiter does not add one. When an
+// enclosure is given, its first character is dropped from the front of each
+// token and its last character from the back, e.g. L"\"" for quoted names.
+template <typename Char>
+class StringTokens {
+ public:
+  using View = std::basic_string_view<Char>;
+
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = View;
+    using difference_type = ptrdiff_t;
+    using pointer = const View*;
+    using reference = const View&;
+
+    Iterator() = default;
+    Iterator(const StringTokens* tokens, size_t start)
+        : tokens_(tokens), start_(start) {
+      Read();
+    }
+
+    reference operator*() const { return token_; }
+    pointer operator->() const { return &token_; }
+
+    Iterator& operator++() {
+      start_ = end_ + 1;
+      Read();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return start_ == other.start_;
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    void Read() {
+      const View& text = tokens_->text_;
+      if (start_ >= text.size()) {
+        start_ = text.size();
+        return;
+      }
+      end_ = text.find(tokens_->delim_, start_);
+      if (end_ == View::npos)
+        end_ = text.size();
+      token_ = text.substr(start_, end_ - start_);
+
+      const View& enclosure = tokens_->enclosure_;
+      if (!enclosure.empty() && !token_.empty() &&
+          token_.front() == enclosure.front()) {
+        token_.remove_prefix(1);
+      }
+      if (!enclosure.empty() && !token_.empty() &&
+          token_.back() == enclosure.back()) {
+        token_.remove_suffix(1);
+      }
+    }
+
+    const StringTokens* tokens_ = nullptr;
+    size_t start_ = 0;
+    size_t end_ = 0;
+    View token_;
+  };
+
+  StringTokens(View text, Char delim, View enclosure)
+      : text_(text), delim_(delim), enclosure_(enclosure) {}
+
+  Iterator begin() const { return Iterator(this, 0); }
+  Iterator end() const { return Iterator(this, text_.size()); }
+  bool empty() const { return text_.empty(); }
+
+ private:
+  View text_;
+  Char delim_;
+  View enclosure_;
+};
+
+StringTokens<char> StringSplit(std::string_view text,
+                               char delim,
+                               std::string_view enclosure = {}) {
+  return StringTokens<char>(text, delim, enclosure);
+}
+
+StringTokens<wchar_t> StringSplit(std::wstring_view text,
+                                  wchar_t delim,
+                                  std::wstring_view enclosure = {}) {
+  return StringTokens<wchar_t>(text, delim, enclosure);
+}
+
+#endif  // STRINGSPLIT_H_
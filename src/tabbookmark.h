@@ -21,7 +21,7 @@ bool IsPressed(int key) {
 // fault tolerance to prevent users from directly closing the window when
 // they click too fast.
 bool IsNeedKeep(NodePtr top_container_view) {
-  if (!IsKeepLastTab()) {
+  if (!GetConfig().keep_last_tab) {
     return false;
   }
 
@@ -59,30 +59,11 @@ NodePtr HandleFindBar(HWND hwnd, POINT pt) {
   return top_container_view;
 }
 
-class IniConfig {
- public:
-  IniConfig()
-      : is_double_click_close(IsDoubleClickClose()),
-        is_right_click_close(IsRightClickClose()),
-        is_wheel_tab(IsWheelTab()),
-        is_wheel_tab_when_press_right_button(IsWheelTabWhenPressRightButton()),
-        is_bookmark_new_tab(IsBookmarkNewTab()),
-        is_open_url_new_tab(IsOpenUrlNewTabFun()) {}
-
-  bool is_double_click_close;
-  bool is_right_click_close;
-  bool is_wheel_tab;
-  bool is_wheel_tab_when_press_right_button;
-  std::string is_bookmark_new_tab;
-  std::string is_open_url_new_tab;
-};
-
-IniConfig config;
-
 // Use the mouse wheel to switch tabs
 bool HandleMouseWheel(WPARAM wParam, LPARAM lParam, PMOUSEHOOKSTRUCT pmouse) {
+  const Config& config = GetConfig();
   if (wParam != WM_MOUSEWHEEL ||
-      (!config.is_wheel_tab && !config.is_wheel_tab_when_press_right_button)) {
+      (!config.wheel_tab && !config.wheel_tab_when_press_rbutton)) {
     return false;
   }
 
@@ -93,7 +74,7 @@ bool HandleMouseWheel(WPARAM wParam, LPARAM lParam, PMOUSEHOOKSTRUCT pmouse) {
   int zDelta = GET_WHEEL_DELTA_WPARAM(pwheel->mouseData);
 
   // If the mouse wheel is used to switch tabs when the mouse is on the tab bar.
-  if (config.is_wheel_tab && IsOnTheTabBar(top_container_view, pmouse->pt)) {
+  if (config.wheel_tab && IsOnTheTabBar(top_container_view, pmouse->pt)) {
     hwnd = GetTopWnd(hwnd);
     if (zDelta > 0) {
       ExecuteCommand(IDC_SELECT_PREVIOUS_TAB, hwnd);
@@ -104,7 +85,7 @@ bool HandleMouseWheel(WPARAM wParam, LPARAM lParam, PMOUSEHOOKSTRUCT pmouse) {
   }
 
   // If it is used to switch tabs when the right button is held.
-  if (config.is_wheel_tab_when_press_right_button && IsPressed(VK_RBUTTON)) {
+  if (config.wheel_tab_when_press_rbutton && IsPressed(VK_RBUTTON)) {
     hwnd = GetTopWnd(hwnd);
     if (zDelta > 0) {
       ExecuteCommand(IDC_SELECT_PREVIOUS_TAB, hwnd);
@@ -119,7 +100,7 @@ bool HandleMouseWheel(WPARAM wParam, LPARAM lParam, PMOUSEHOOKSTRUCT pmouse) {
 
 // Double-click to close tab.
 int HandleDoubleClick(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
-  if (wParam != WM_LBUTTONDBLCLK || !config.is_double_click_close) {
+  if (wParam != WM_LBUTTONDBLCLK || !GetConfig().double_click_close) {
     return 0;
   }
 
@@ -148,7 +129,7 @@ int HandleDoubleClick(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
 // Right-click to close tab (Hold Shift to show the original menu).
 int HandleRightClick(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
   if (wParam != WM_RBUTTONUP || IsPressed(VK_SHIFT) ||
-      !config.is_right_click_close) {
+      !GetConfig().right_click_close) {
     return 0;
   }
 
@@ -203,8 +184,9 @@ int HandleMiddleClick(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
 
 // Open bookmarks in a new tab.
 bool HandleBookmark(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
+  NewTabOpen open = GetConfig().open_bookmark_new_tab;
   if (wParam != WM_LBUTTONUP || IsPressed(VK_CONTROL) || IsPressed(VK_SHIFT) ||
-      config.is_bookmark_new_tab == "disabled") {
+      open == kNewTabDisabled) {
     return false;
   }
 
@@ -221,9 +203,9 @@ bool HandleBookmark(WPARAM wParam, PMOUSEHOOKSTRUCT pmouse) {
   bool is_on_new_tab = IsOnNewTab(top_container_view);
 
   if (is_on_bookmark && !is_on_new_tab) {
-    if (config.is_bookmark_new_tab == "foreground") {
+    if (open == kNewTabForeground) {
       SendKey(VK_MBUTTON, VK_SHIFT);
-    } else if (config.is_bookmark_new_tab == "background") {
+    } else if (open == kNewTabBackground) {
       SendKey(VK_MBUTTON);
     }
     return true;
@@ -416,16 +398,17 @@ int HandleKeepTab(WPARAM wParam) {
 }
 
 int HandleOpenUrlNewTab(WPARAM wParam) {
-  if (!(config.is_open_url_new_tab != "disabled" && wParam == VK_RETURN &&
+  NewTabOpen open = GetConfig().open_url_new_tab;
+  if (!(open != kNewTabDisabled && wParam == VK_RETURN &&
         !IsPressed(VK_MENU))) {
     return 0;
   }
 
   NodePtr top_container_view = GetTopContainerView(GetForegroundWindow());
   if (IsOmniboxFocus(top_container_view) && !IsOnNewTab(top_container_view)) {
-    if (config.is_open_url_new_tab == "foreground") {
+    if (open == kNewTabForeground) {
       SendKey(VK_MENU, VK_RETURN);
-    } else if (config.is_open_url_new_tab == "background") {
+    } else if (open == kNewTabBackground) {
       SendKey(VK_SHIFT, VK_MENU, VK_RETURN);
     }
     return 1;
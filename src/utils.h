@@ -13,6 +13,13 @@
 #pragma comment(lib, "Shlwapi.lib")
 
 #include "FastSearch.h"
+#include "inifile.h"
+#include "peimage.h"
+#include "multisearch.h"
+#include "parallelsearch.h"
+#include "signature.h"
+#include "stringreplace.h"
+#include "stringsplit.h"
 
 // https://source.chromium.org/chromium/chromium/src/+/main:chrome/app/chrome_command_ids.h?q=chrome_command_ids.h&ss=chromium%2Fchromium%2Fsrc
 #define IDC_NEW_TAB 34014
@@ -68,108 +75,6 @@ std::string wstring_to_string(const std::wstring& wstr) {
   return strTo;
 }
 
-// Specify the delimiter and wrapper to split the string.
-std::vector<std::wstring> StringSplit(const std::wstring& str,
-                                      const wchar_t delim,
-                                      const std::wstring& enclosure) {
-  std::vector<std::wstring> result;
-  std::wstring::size_type start = 0;
-  std::wstring::size_type end = str.find(delim);
-  while (end != std::wstring::npos) {
-    std::wstring name = str.substr(start, end - start);
-    if (!enclosure.empty() && !name.empty() &&
-        name.front() == enclosure.front()) {
-      name.erase(0, 1);
-    }
-    if (!enclosure.empty() && !name.empty() &&
-        name.back() == enclosure.back()) {
-      name.erase(name.size() - 1);
-    }
-    result.push_back(name);
-    start = end + 1;
-    end = str.find(delim, start);
-  }
-  if (start < str.length()) {
-    std::wstring name = str.substr(start);
-    if (!enclosure.empty() && !name.empty() &&
-        name.front() == enclosure.front()) {
-      name.erase(0, 1);
-    }
-    if (!enclosure.empty() && !name.empty() &&
-        name.back() == enclosure.back()) {
-      name.erase(name.size() - 1);
-    }
-    result.push_back(name);
-  }
-  return result;
-}
-
-// Compression html.
-std::string& ltrim(std::string& s) {
-  s.erase(s.begin(), std::find_if(s.begin(), s.end(),
-                                  [](int ch) { return !std::isspace(ch); }));
-  return s;
-}
-std::string& rtrim(std::string& s) {
-  s.erase(std::find_if(s.rbegin(), s.rend(),
-                       [](int ch) { return !std::isspace(ch); })
-              .base(),
-          s.end());
-  return s;
-}
-
-std::string& trim(std::string& s) {
-  return ltrim(rtrim(s));
-}
-
-std::vector<std::string> split(const std::string& text, char sep) {
-  std::vector<std::string> tokens;
-  std::size_t start = 0, end = 0;
-  while ((end = text.find(sep, start)) != std::string::npos) {
-    std::string temp = text.substr(start, end - start);
-    tokens.push_back(temp);
-    start = end + 1;
-  }
-  std::string temp = text.substr(start);
-  tokens.push_back(temp);
-  return tokens;
-}
-
-void compression_html(std::string& html) {
-  auto lines = split(html, '\n');
-  html.clear();
-  for (auto& line : lines) {
-    html += "\n";
-    html += trim(line);
-  }
-}
-
-bool ReplaceStringInPlace(std::string& subject,
-                          const std::string& search,
-                          const std::string& replace) {
-  bool find = false;
-  size_t pos = 0;
-  while ((pos = subject.find(search, pos)) != std::string::npos) {
-    subject.replace(pos, search.length(), replace);
-    pos += replace.length();
-    find = true;
-  }
-  return find;
-}
-
-bool ReplaceStringInPlace(std::wstring& subject,
-                          const std::wstring& search,
-                          const std::wstring& replace) {
-  bool find = false;
-  size_t pos = 0;
-  while ((pos = subject.find(search, pos)) != std::wstring::npos) {
-    subject.replace(pos, search.length(), replace);
-    pos += replace.length();
-    find = true;
-  }
-  return find;
-}
-
 std::wstring QuoteSpaceIfNeeded(const std::wstring& str) {
   if (str.find(L' ') == std::wstring::npos)
     return std::move(str);
@@ -204,44 +109,52 @@ uint8_t* memmem(uint8_t* src, int n, const uint8_t* sub, int m) {
   return (uint8_t*)FastSearch(src, n, sub, m);
 }
 
+// Search the raw data of a section of the module. chrome.dll sections are
+// large enough to be worth splitting across threads.
+uint8_t* SearchModuleSection(HMODULE module,
+                             const char* name,
+                             const uint8_t* sub,
+                             int m) {
+  PeSection section;
+  if (!FindPeSection((uint8_t*)module, 0, name, section))
+    return nullptr;
+  return (uint8_t*)ParallelSearch(section.data, section.size, sub, m);
+}
+
+uint8_t* SearchModuleSection(HMODULE module,
+                             const char* name,
+                             const Signature& signature) {
+  PeSection section;
+  if (!FindPeSection((uint8_t*)module, 0, name, section))
+    return nullptr;
+  return signature.Search(section.data, section.size);
+}
+
+// Find all signatures registered in |searcher| with one pass over the section.
+std::vector<std::vector<const uint8_t*>> SearchModuleSection(
+    HMODULE module,
+    const char* name,
+    MultiSearcher& searcher) {
+  PeSection section;
+  if (!FindPeSection((uint8_t*)module, 0, name, section))
+    return std::vector<std::vector<const uint8_t*>>(searcher.size());
+  return searcher.FindAll(section.data, section.size);
+}
+
 uint8_t* SearchModuleRaw(HMODULE module, const uint8_t* sub, int m) {
-  uint8_t* buffer = (uint8_t*)module;
-
-  PIMAGE_NT_HEADERS nt_header =
-      (PIMAGE_NT_HEADERS)(buffer + ((PIMAGE_DOS_HEADER)buffer)->e_lfanew);
-  PIMAGE_SECTION_HEADER section =
-      (PIMAGE_SECTION_HEADER)((char*)nt_header + sizeof(DWORD) +
-                              sizeof(IMAGE_FILE_HEADER) +
-                              nt_header->FileHeader.SizeOfOptionalHeader);
-
-  for (int i = 0; i < nt_header->FileHeader.NumberOfSections; ++i) {
-    if (strcmp((const char*)section[i].Name, ".text") == 0) {
-      return memmem(buffer + section[i].PointerToRawData,
-                    section[i].SizeOfRawData, sub, m);
-      break;
-    }
-  }
-  return nullptr;
+  return SearchModuleSection(module, ".text", sub, m);
+}
+
+uint8_t* SearchModuleRaw(HMODULE module, const Signature& signature) {
+  return SearchModuleSection(module, ".text", signature);
 }
 
 uint8_t* SearchModuleRaw2(HMODULE module, const uint8_t* sub, int m) {
-  uint8_t* buffer = (uint8_t*)module;
-
-  PIMAGE_NT_HEADERS nt_header =
-      (PIMAGE_NT_HEADERS)(buffer + ((PIMAGE_DOS_HEADER)buffer)->e_lfanew);
-  PIMAGE_SECTION_HEADER section =
-      (PIMAGE_SECTION_HEADER)((char*)nt_header + sizeof(DWORD) +
-                              sizeof(IMAGE_FILE_HEADER) +
-                              nt_header->FileHeader.SizeOfOptionalHeader);
-
-  for (int i = 0; i < nt_header->FileHeader.NumberOfSections; ++i) {
-    if (strcmp((const char*)section[i].Name, ".rdata") == 0) {
-      return memmem(buffer + section[i].PointerToRawData,
-                    section[i].SizeOfRawData, sub, m);
-      break;
-    }
-  }
-  return nullptr;
+  return SearchModuleSection(module, ".rdata", sub, m);
+}
+
+uint8_t* SearchModuleRaw2(HMODULE module, const Signature& signature) {
+  return SearchModuleSection(module, ".rdata", signature);
 }
 
 // bool WriteMemory(PBYTE BaseAddress, PBYTE Buffer, DWORD nSize) {
@@ -278,24 +191,22 @@ bool isEndWith(const wchar_t* s, const wchar_t* sub) {
 
 const std::wstring kIniPath = GetAppDir() + L"\\chrome++.ini";
 
-// Prase the INI file.
-std::wstring GetIniString(const std::wstring& section,
-                          const std::wstring& key,
-                          const std::wstring& default_value) {
-  std::vector<TCHAR> buffer(100);
-  DWORD bytesread = 0;
-  do {
-    bytesread = ::GetPrivateProfileStringW(
-        section.c_str(), key.c_str(), default_value.c_str(), buffer.data(),
-        (DWORD)buffer.size(), kIniPath.c_str());
-    if (bytesread >= buffer.size() - 1) {
-      buffer.resize(buffer.size() * 2);
-    } else {
-      break;
-    }
-  } while (true);
-
-  return std::wstring(buffer.data());
+// Read and parse an INI file. A missing file leaves |ini| empty.
+bool LoadIniFile(const std::wstring& path, IniFile& ini) {
+  FILE* fp = nullptr;
+  if (_wfopen_s(&fp, path.c_str(), L"rb") != 0 || !fp) {
+    ini.Parse({});
+    return false;
+  }
+  std::string raw;
+  char chunk[16 * 1024];
+  size_t read;
+  while ((read = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    raw.append(chunk, read);
+  }
+  fclose(fp);
+  ini.Parse(raw);
+  return true;
 }
 
 // Canonicalize the path.
@@ -0,0 +1,204 @@
+// Runs every search kernel of fastsearch.h against a naive search, and
+// checks the Searcher built from a literal and its FindAll range.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fastsearch.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+const uint8_t* NaiveSearch(const uint8_t* s, int n, const uint8_t* p, int m) {
+  for (int i = 0; i + m <= n; ++i) {
+    if (memcmp(s + i, p, m) == 0)
+      return s + i;
+  }
+  return nullptr;
+}
+
+struct NamedKernel {
+  const char* name;
+  SearchKernel search;
+};
+
+std::vector<NamedKernel> GetKernels() {
+  std::vector<NamedKernel> kernels = {
+      {"FastSearch", FastSearch},
+      {"ScalarSearch", ScalarSearch},
+      {"SundaySearch", SundaySearch},
+      {"TwoWaySearch", TwoWaySearch},
+  };
+#ifdef FASTSEARCH_X86
+  kernels.push_back({"Sse2Search", Sse2Search});
+  if (IsAvx2Supported())
+    kernels.push_back({"Avx2Search", Avx2Search});
+  else
+    printf("AVX2 not supported, Avx2Search is not tested\n");
+#endif
+  return kernels;
+}
+
+const std::vector<NamedKernel> kKernels = GetKernels();
+
+// Every kernel must find the leftmost match, or none.
+void CheckSearch(const Bytes& s, const Bytes& p, const char* what) {
+  const int n = (int)s.size();
+  const int m = (int)p.size();
+  const uint8_t* expected = NaiveSearch(s.data(), n, p.data(), m);
+  for (const NamedKernel& kernel : kKernels) {
+    const uint8_t* found = kernel.search(s.data(), n, p.data(), m);
+    if (found != expected) {
+      fprintf(stderr, "%s: %s n=%d m=%d found %d expected %d\n", what,
+              kernel.name, n, m, found ? (int)(found - s.data()) : -1,
+              expected ? (int)(expected - s.data()) : -1);
+      ++test_failures;
+    }
+  }
+  if (m == 1) {
+    const uint8_t* found = ForceSearch(s.data(), n, p.data());
+    EXPECT(found == expected);
+  }
+}
+
+Bytes RandomBytes(std::mt19937& rng, int size, int alphabet) {
+  Bytes bytes(size);
+  for (auto& c : bytes) {
+    c = (uint8_t)('a' + rng() % alphabet);
+  }
+  return bytes;
+}
+
+// Small alphabets give many partial matches, 256 letters almost none.
+void TestRandom(std::mt19937& rng) {
+  for (int alphabet : {2, 4, 256}) {
+    for (int round = 0; round < 3000; ++round) {
+      int m = 1 + rng() % 64;
+      int n = m + rng() % 300;
+      Bytes s = RandomBytes(rng, n, alphabet);
+      Bytes p = RandomBytes(rng, m, alphabet);
+      if (round & 1) {
+        // Take the needle from the haystack so that there is a match.
+        int at = rng() % (n - m + 1);
+        p.assign(s.begin() + at, s.begin() + at + m);
+      }
+      CheckSearch(s, p, "random");
+    }
+  }
+}
+
+// A single copy of the needle in a haystack of a byte the needle does not
+// contain.
+Bytes PlaceNeedle(int n, const Bytes& p, int at) {
+  Bytes s(n, 'x');
+  std::copy(p.begin(), p.end(), s.begin() + at);
+  return s;
+}
+
+void TestPositions(std::mt19937& rng) {
+  for (int m = 1; m <= 64; ++m) {
+    Bytes p = RandomBytes(rng, m, 8);
+    for (int n : {m, m + 1, m + 15, m + 16, m + 31, m + 32, m + 33, 200}) {
+      CheckSearch(PlaceNeedle(n, p, 0), p, "start");
+      CheckSearch(PlaceNeedle(n, p, n - m), p, "end");
+    }
+
+    // Starts and ends on either side of the 16 and 32 byte block edges.
+    for (int edge : {16, 32, 48, 64, 96, 128}) {
+      for (int at = edge - m - 1; at <= edge + 1; ++at) {
+        if (at < 0)
+          continue;
+        CheckSearch(PlaceNeedle(edge + 2 * 64, p, at), p, "edge");
+      }
+    }
+  }
+}
+
+void TestNoMatch(std::mt19937& rng) {
+  for (int m = 1; m <= 64; ++m) {
+    Bytes p = RandomBytes(rng, m, 8);
+    for (int n : {m, m + 7, m + 16, m + 32, 500}) {
+      CheckSearch(Bytes(n, 'x'), p, "no match");
+
+      // Every copy but the last byte, so the first byte filter passes.
+      Bytes s(n, 'x');
+      for (int at = 0; at + m <= n; at += m) {
+        std::copy(p.begin(), p.end() - 1, s.begin() + at);
+      }
+      CheckSearch(s, p, "near miss");
+    }
+  }
+}
+
+// Repetitive input that exceeds the comparison budget and falls back to
+// Two-Way in the middle of the scan.
+void TestRepetitive() {
+  for (int m : {2, 17, 33, 64, 600}) {
+    Bytes p(m, 0);
+    p[m / 2] = 1;
+    for (int n : {m, 5000, 100000}) {
+      Bytes s(n, 0);
+      CheckSearch(s, p, "zeros");
+      std::copy(p.begin(), p.end(), s.end() - m);
+      CheckSearch(s, p, "zeros, match at end");
+    }
+  }
+}
+
+constexpr Searcher kAb("ab");
+constexpr Searcher kAa("aa");
+constexpr Searcher kLong("longer than the haystack");
+
+std::vector<int> FindAllOffsets(const Searcher& searcher,
+                                const std::string& s) {
+  std::vector<int> offsets;
+  const uint8_t* data = (const uint8_t*)s.data();
+  for (const uint8_t* match : searcher.FindAll(data, (int)s.size())) {
+    offsets.push_back((int)(match - data));
+  }
+  return offsets;
+}
+
+void TestSearcher(std::mt19937& rng) {
+  EXPECT(kAb.size() == 2 && memcmp(kAb.pattern(), "ab", 2) == 0);
+
+  // Adjacent matches are all found, overlapping ones only from the end of
+  // the previous match.
+  EXPECT(FindAllOffsets(kAb, "ababxab") == std::vector<int>({0, 2, 5}));
+  EXPECT(FindAllOffsets(kAa, "aaaaa") == std::vector<int>({0, 2}));
+  EXPECT(FindAllOffsets(kAa, "aaaa") == std::vector<int>({0, 2}));
+  EXPECT(FindAllOffsets(kAb, "ba").empty());
+
+  // Nothing in an empty haystack or one shorter than the needle.
+  EXPECT(FindAllOffsets(kAb, "").empty());
+  EXPECT(FindAllOffsets(kAb, "a").empty());
+  EXPECT(FindAllOffsets(kLong, "longer than").empty());
+  EXPECT(kLong.Search((const uint8_t*)"longer", 6) == nullptr);
+  EXPECT(kAb.Search((const uint8_t*)nullptr, 0) == nullptr);
+
+  // The table built at compile time searches like the one built at run
+  // time, and like the naive search.
+  const Searcher runtime((const uint8_t*)"ab", 2);
+  for (int round = 0; round < 1000; ++round) {
+    Bytes s = RandomBytes(rng, rng() % 100, 3);
+    const uint8_t* expected =
+        NaiveSearch(s.data(), (int)s.size(), (const uint8_t*)"ab", 2);
+    EXPECT(kAb.Search(s.data(), (int)s.size()) == expected);
+    EXPECT(runtime.Search(s.data(), (int)s.size()) == expected);
+  }
+}
+
+int main() {
+  std::mt19937 rng(20240101);
+  TestRandom(rng);
+  TestPositions(rng);
+  TestNoMatch(rng);
+  TestRepetitive();
+  TestSearcher(rng);
+  return TestResult();
+}
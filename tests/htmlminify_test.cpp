@@ -0,0 +1,151 @@
+// Checks MinifyWhitespace of htmlminify.h: kMinifyLines against the
+// compression_html utils.h used, and what kMinifyHtml leaves untouched.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "htmlminify.h"
+#include "testing.h"
+
+std::string Minify(std::string text, MinifyMode mode) {
+  uint32_t size =
+      MinifyWhitespace((uint8_t*)&text[0], (uint32_t)text.size(), mode);
+  EXPECT(size <= text.size());
+  return text.substr(0, size);
+}
+
+// The line trimming utils.h used, which starts every line with a newline.
+std::string CompressionHtml(const std::string& html) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  size_t end = 0;
+  while ((end = html.find('\n', start)) != std::string::npos) {
+    lines.push_back(html.substr(start, end - start));
+    start = end + 1;
+  }
+  lines.push_back(html.substr(start));
+
+  auto space = [](int ch) { return std::isspace(ch); };
+  std::string result;
+  for (std::string& line : lines) {
+    line.erase(std::find_if_not(line.rbegin(), line.rend(), space).base(),
+               line.end());
+    line.erase(line.begin(), std::find_if_not(line.begin(), line.end(), space));
+    result += "\n";
+    result += line;
+  }
+  return result;
+}
+
+void CheckHtml(const std::string& text, const std::string& expected) {
+  std::string result = Minify(text, kMinifyHtml);
+  if (result != expected) {
+    fprintf(stderr, "\"%s\" became \"%s\"\n", text.c_str(), result.c_str());
+    ++test_failures;
+  }
+}
+
+// Lines mode is compression_html without the newline it puts first.
+void TestLines() {
+  const char* texts[] = {
+      "",
+      "a",
+      "  a  ",
+      "a\nb",
+      "  a  \n\t b c \r\n\n  d\n",
+      "\n\n",
+      " \v\f\n x",
+      "<div  class=\"a  b\">\n    text   here\n  </div>\n",
+  };
+  for (const char* text : texts) {
+    EXPECT("\n" + Minify(text, kMinifyLines) == CompressionHtml(text));
+  }
+
+  // Long enough for the 16 byte blocks, with every kind of whitespace.
+  std::mt19937 rng(20240101);
+  const char kBytes[] = "ab<\" \t\n\r\v\f";
+  for (int round = 0; round < 2000; ++round) {
+    std::string text(rng() % 120, 'a');
+    for (auto& c : text) {
+      c = kBytes[rng() % 4 ? rng() % 5 : rng() % (sizeof(kBytes) - 1)];
+    }
+    if ("\n" + Minify(text, kMinifyLines) != CompressionHtml(text)) {
+      fprintf(stderr, "round %d: %zu bytes\n", round, text.size());
+      ++test_failures;
+    }
+  }
+
+  EXPECT(Minify(" a  b ", kMinifyNone) == " a  b ");
+  EXPECT(Minify(" a  \n\t b ", kMinifyCollapse) == " a\nb ");
+}
+
+// Text and the space between attributes collapse, quoted values do not.
+void TestHtml() {
+  CheckHtml("<p   class=\"a   b\"  title='  x '>  some \n\n text  </p>",
+            "<p class=\"a   b\" title='  x '> some\ntext </p>");
+  // A quote in text is only text.
+  CheckHtml("it's   \"so\"   <b>  x  </b>", "it's \"so\" <b> x </b>");
+  // A '<' that does not start a tag.
+  CheckHtml("a  <  b  <1  c", "a < b <1 c");
+}
+
+// The contents of raw elements are copied as they are, up to the end tag
+// whatever its case.
+void TestRawElements() {
+  CheckHtml("  <pre>  a\n\n  b  </pre>  x   y",
+            " <pre>  a\n\n  b  </pre> x y");
+  CheckHtml("<script type=\"a\">  if (a  <b) {\n  x = \"  \";\n}  </SCRIPT>  z",
+            "<script type=\"a\">  if (a  <b) {\n  x = \"  \";\n}  </SCRIPT> z");
+  CheckHtml("<style>  a  {  b: c  }  </style >  <textarea>  t  </textarea>",
+            "<style>  a  {  b: c  }  </style > <textarea>  t  </textarea>");
+  // An end tag of another element does not end it.
+  CheckHtml("<pre>  </p>  </pre>  ", "<pre>  </p>  </pre> ");
+  // Names that only start like a raw element are not raw.
+  CheckHtml("<preview>  a  </preview>", "<preview> a </preview>");
+  // Names match without regard to case.
+  CheckHtml("<PRE>  a  </pre>", "<PRE>  a  </pre>");
+  // The name moves with the output when whitespace before it collapses.
+  CheckHtml("x       <style>  a  </style>", "x <style>  a  </style>");
+}
+
+// Comments may hold quotes and tags.
+void TestComments() {
+  CheckHtml("<!--  it's   <pre>  -->   a   b", "<!--  it's   <pre>  --> a b");
+  CheckHtml("a   <!--  \"  -->  <p   x=\"  \">",
+            "a <!--  \"  --> <p x=\"  \">");
+  // An unterminated comment runs to the end.
+  CheckHtml("a   <!--  b   ", "a <!--  b   ");
+  CheckHtml("<!--", "<!--");
+}
+
+// Elements cut off at the end of the buffer.
+void TestTruncated() {
+  // An unterminated start tag is still a tag, its contents never start.
+  CheckHtml("a   <script", "a <script");
+  CheckHtml("a   <script  type=\"x", "a <script type=\"x");
+  // A start tag without its end tag is raw to the end.
+  CheckHtml("<script>  a  ", "<script>  a  ");
+  // An end tag cut after its name still ends the element.
+  CheckHtml("<pre>  a  </pre", "<pre>  a  </pre");
+  CheckHtml("<pre>  a  </pre  ", "<pre>  a  </pre ");
+  // Cut inside the name, the rest is contents.
+  CheckHtml("<pre>  a  </pr", "<pre>  a  </pr");
+  CheckHtml("<pre>  a  </", "<pre>  a  </");
+  CheckHtml("<", "<");
+  CheckHtml("", "");
+}
+
+int main() {
+  TestLines();
+  TestHtml();
+  TestRawElements();
+  TestComments();
+  TestTruncated();
+  return TestResult();
+}
@@ -0,0 +1,152 @@
+// Checks the INI parsing of inifile.h against what GetPrivateProfileString
+// does with the same files.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <string_view>
+
+#include "inifile.h"
+#include "testing.h"
+
+// |text| as UTF-16LE with a BOM, the way Notepad saves chrome++.ini. Only
+// code points below 0x10000, written as given.
+std::string Utf16(const std::u16string& text) {
+  std::string raw = "\xFF\xFE";
+  for (char16_t c : text) {
+    raw += (char)(c & 0xFF);
+    raw += (char)(c >> 8);
+  }
+  return raw;
+}
+
+void TestDecode() {
+  EXPECT(DecodeIniText("") == "");
+  EXPECT(DecodeIniText("[a]\nk=v") == "[a]\nk=v");
+  EXPECT(DecodeIniText("\xEF\xBB\xBF[a]\nk=v") == "[a]\nk=v");
+  EXPECT(DecodeIniText(Utf16(u"[a]\r\nk=v")) == "[a]\r\nk=v");
+
+  // One, two and three byte UTF-8.
+  EXPECT(DecodeIniText(Utf16(u"Aé中")) == "A\xC3\xA9\xE4\xB8\xAD");
+
+  // A surrogate pair is one four byte character, U+1F600.
+  EXPECT(DecodeIniText(Utf16(u"\xD83D\xDE00")) == "\xF0\x9F\x98\x80");
+  // A lone high surrogate is kept as a three byte sequence.
+  EXPECT(DecodeIniText(Utf16(u"\xD83Dx")) == "\xED\xA0\xBDx");
+
+  // A trailing odd byte is dropped.
+  EXPECT(DecodeIniText(Utf16(u"ab") + "c") == "ab");
+}
+
+void TestUtf8ToWide() {
+  EXPECT(Utf8ToWide("") == L"");
+  EXPECT(Utf8ToWide("abc") == L"abc");
+  EXPECT(Utf8ToWide("A\xC3\xA9\xE4\xB8\xAD") == L"Aé中");
+
+  std::wstring smile = Utf8ToWide("\xF0\x9F\x98\x80");
+  if (sizeof(wchar_t) == 2) {
+    EXPECT(smile.size() == 2 && smile[0] == 0xD83D && smile[1] == 0xDE00);
+  } else {
+    EXPECT(smile.size() == 1 && (uint32_t)smile[0] == 0x1F600);
+  }
+
+  // Truncated sequences keep their bytes.
+  std::wstring cut = Utf8ToWide("a\xE4\xB8");
+  EXPECT(cut.size() == 3 && cut[0] == L'a' && cut[1] == 0xE4 &&
+         cut[2] == 0xB8);
+
+  // Round trip through UTF-16LE.
+  EXPECT(Utf8ToWide(DecodeIniText(Utf16(u"中\xD83D\xDE00"))) ==
+         Utf8ToWide("\xE4\xB8\xAD\xF0\x9F\x98\x80"));
+}
+
+void TestParse() {
+  IniFile ini;
+  ini.Parse(
+      "\xEF\xBB\xBF"
+      "; comment\n"
+      "orphan=before any section\n"
+      "[General]\n"
+      "  Name  =  value with spaces  \r\n"
+      "quoted=\"  kept  \"\n"
+      "single='x'\n"
+      "mismatched=\"x'\n"
+      "lone=\"\n"
+      "empty=\n"
+      "no equal sign\n"
+      "name=second\n"
+      "[ other ]\n"
+      "key=1\n"
+      "[general]\n"
+      "name=third\n"
+      "extra=only here\n"
+      "[unclosed\n"
+      "k=v");
+
+  EXPECT(ini.sections().size() == 4);
+  EXPECT(ini.sections()[1].name == "other");
+  EXPECT(ini.sections()[3].name == "unclosed");
+
+  // Names match without regard to case, the first key and section win.
+  EXPECT(ini.Get("general", "NAME") == "value with spaces");
+  EXPECT(ini.Get("GENERAL", "name") == "value with spaces");
+  EXPECT(ini.Find("general", "extra") == nullptr);
+  EXPECT(ini.sections()[2].Get("extra") == "only here");
+  EXPECT(ini.Find("general", "orphan") == nullptr);
+
+  // One pair of matching quotes is dropped.
+  EXPECT(ini.Get("general", "quoted") == "  kept  ");
+  EXPECT(ini.Get("general", "single") == "x");
+  EXPECT(ini.Get("general", "mismatched") == "\"x'");
+  EXPECT(ini.Get("general", "lone") == "\"");
+
+  // Empty is not missing.
+  EXPECT(ini.Find("general", "empty") != nullptr);
+  EXPECT(ini.Get("general", "empty", "default") == "");
+  EXPECT(ini.Get("general", "missing", "default") == "default");
+  EXPECT(ini.Get("missing", "name", "default") == "default");
+
+  EXPECT(ini.Get("other", "key") == "1");
+  EXPECT(ini.Get("unclosed", "k") == "v");
+}
+
+void TestUtf16File() {
+  IniFile ini;
+  ini.Parse(Utf16(u"[设置]\r\nkey=\xD83D\xDE00\r\n"));
+  EXPECT(ini.Get("\xE8\xAE\xBE\xE7\xBD\xAE", "key") == "\xF0\x9F\x98\x80");
+}
+
+void TestGetInt() {
+  IniFile ini;
+  ini.Parse(
+      "[n]\n"
+      "plain=42\n"
+      "negative=-7\n"
+      "trailing=12abc\n"
+      "word=abc\n"
+      "empty=\n"
+      "minus=-\n"
+      "spaced=  5  \n"
+      "quoted=\"9\"\n");
+  EXPECT(ini.GetInt("n", "plain", 1) == 42);
+  EXPECT(ini.GetInt("n", "negative", 1) == -7);
+  EXPECT(ini.GetInt("n", "trailing", 1) == 12);
+  // A value that is not a number is 0, not the default.
+  EXPECT(ini.GetInt("n", "word", 1) == 0);
+  EXPECT(ini.GetInt("n", "empty", 1) == 0);
+  EXPECT(ini.GetInt("n", "minus", 1) == 0);
+  EXPECT(ini.GetInt("n", "spaced", 1) == 5);
+  EXPECT(ini.GetInt("n", "quoted", 1) == 9);
+  EXPECT(ini.GetInt("n", "missing", 1) == 1);
+  EXPECT(ini.GetInt("missing", "plain", -1) == -1);
+}
+
+int main() {
+  TestDecode();
+  TestUtf8ToWide();
+  TestParse();
+  TestUtf16File();
+  TestGetInt();
+  return TestResult();
+}
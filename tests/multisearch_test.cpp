@@ -0,0 +1,126 @@
+// Checks that MultiSearcher reports every match of every signature, the same
+// as searching for each one on its own.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "multisearch.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+Bytes ToBytes(const std::string& text) {
+  return Bytes(text.begin(), text.end());
+}
+
+// Every start of |p| in |s|, overlapping ones included. A zero mask byte is
+// a wildcard.
+std::vector<const uint8_t*> NaiveFindAll(const Bytes& s,
+                                         const Bytes& p,
+                                         const Bytes& mask) {
+  std::vector<const uint8_t*> hits;
+  for (size_t i = 0; i + p.size() <= s.size(); ++i) {
+    size_t k = 0;
+    while (k < p.size() && !((s[i + k] ^ p[k]) & mask[k])) {
+      ++k;
+    }
+    if (k == p.size())
+      hits.push_back(s.data() + i);
+  }
+  return hits;
+}
+
+// Search |s| for plain |patterns| at once and compare with each on its own.
+void CheckPatterns(const Bytes& s,
+                   const std::vector<std::string>& patterns,
+                   const char* what) {
+  MultiSearcher searcher;
+  for (const std::string& pattern : patterns) {
+    EXPECT(searcher.Add((const uint8_t*)pattern.data(),
+                        (int)pattern.size()) == searcher.size() - 1);
+  }
+  std::vector<std::vector<const uint8_t*>> hits =
+      searcher.FindAll(s.data(), (int)s.size());
+  EXPECT(hits.size() == patterns.size());
+  for (size_t id = 0; id < patterns.size(); ++id) {
+    Bytes p = ToBytes(patterns[id]);
+    if (hits[id] != NaiveFindAll(s, p, Bytes(p.size(), 0xFF))) {
+      fprintf(stderr, "%s: \"%s\" has %zu hits\n", what,
+              patterns[id].c_str(), hits[id].size());
+      ++test_failures;
+    }
+  }
+}
+
+void TestFixed() {
+  Bytes s = ToBytes("abababcabcababcaaaabcbca");
+
+  // Patterns that overlap each other and themselves.
+  CheckPatterns(s, {"aba", "bab", "abab"}, "overlapping");
+  // One pattern is a prefix or a suffix of another.
+  CheckPatterns(s, {"ab", "abc", "abca", "bca", "ca", "a"}, "affixes");
+  // The same pattern twice gets two ids and the same hits.
+  CheckPatterns(s, {"abc", "bc", "abc"}, "duplicates");
+  // Single bytes, one absent.
+  CheckPatterns(s, {"a", "b", "c", "z"}, "single bytes");
+  // More first bytes than the vector skip takes.
+  CheckPatterns(s, {"a", "b", "c", "d", "e", "f", "g", "h", "i", "ab"},
+                "many starts");
+
+  // Matches at both ends, and none in a buffer shorter than the pattern.
+  CheckPatterns(ToBytes("abcxyzabc"), {"abc", "xyz", "bcx"}, "ends");
+  CheckPatterns(ToBytes("ab"), {"abc", "b"}, "short");
+
+  MultiSearcher empty;
+  EXPECT(empty.FindAll(s.data(), (int)s.size()).empty());
+  EXPECT(empty.Add(nullptr, 0) == -1);
+}
+
+// A match must fit the buffer even when its anchor does.
+void TestWildcards() {
+  MultiSearcher searcher;
+  Signature head("?? 62 63");
+  Signature tail("61 62 ??");
+  EXPECT(searcher.Add(head) == 0);
+  EXPECT(searcher.Add(tail) == 1);
+  EXPECT(searcher.Add(Signature("?? ??")) == -1);
+
+  Bytes s = ToBytes("bcxabcab");
+  std::vector<std::vector<const uint8_t*>> hits =
+      searcher.FindAll(s.data(), (int)s.size());
+  EXPECT(hits[0].size() == 1 && hits[0][0] == s.data() + 3);
+  EXPECT(hits[1].size() == 1 && hits[1][0] == s.data() + 3);
+}
+
+// Random text over a small alphabet against random pattern sets, long
+// enough to go through the 16 byte vector skip.
+void TestRandom() {
+  std::mt19937 rng(20240101);
+  for (int round = 0; round < 500; ++round) {
+    int alphabet = 2 + rng() % 4;
+    Bytes s(rng() % 600);
+    for (auto& c : s) {
+      c = (uint8_t)('a' + rng() % alphabet);
+    }
+    std::vector<std::string> patterns(1 + rng() % 12);
+    for (auto& pattern : patterns) {
+      pattern.resize(1 + rng() % 6);
+      for (auto& c : pattern) {
+        c = (char)('a' + rng() % alphabet);
+      }
+    }
+    CheckPatterns(s, patterns, "random");
+  }
+}
+
+int main() {
+  TestFixed();
+  TestWildcards();
+  TestRandom();
+  return TestResult();
+}
@@ -0,0 +1,365 @@
+// Checks the pak table validation and lookups of pakfile.h on synthetic
+// PAK5 files, the recompression into a fixed slot, the arena reuse of the
+// traversal and the sidecar cache.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// pakfile.h logs through DebugLog, which the dll takes from utils.h.
+void DebugLog(const wchar_t*, ...) {}
+
+#include "pakfile.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct PakSource {
+  std::vector<std::pair<uint16_t, std::string>> resources;
+  // Alias id and the index of the entry it shares.
+  std::vector<std::pair<uint16_t, uint16_t>> aliases;
+};
+
+void Append(Bytes& out, const void* data, size_t size) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// Lay out a PAK5 file the way Chrome writes it, in the order given.
+Bytes BuildPak(const PakSource& source) {
+  uint32_t version = PACK5_FILE_VERSION;
+  PAK5_HEADER header = {1, (uint16_t)source.resources.size(),
+                        (uint16_t)source.aliases.size()};
+  uint32_t offset = (uint32_t)(sizeof(version) + sizeof(header) +
+                               (source.resources.size() + 1) *
+                                   sizeof(PAK_ENTRY) +
+                               source.aliases.size() * sizeof(PAK_ALIAS));
+  Bytes pak;
+  Append(pak, &version, sizeof(version));
+  Append(pak, &header, sizeof(header));
+  for (const auto& resource : source.resources) {
+    PAK_ENTRY entry = {resource.first, offset};
+    Append(pak, &entry, sizeof(entry));
+    offset += (uint32_t)resource.second.size();
+  }
+  PAK_ENTRY end = {0, offset};
+  Append(pak, &end, sizeof(end));
+  for (const auto& alias : source.aliases) {
+    PAK_ALIAS entry = {alias.first, alias.second};
+    Append(pak, &entry, sizeof(entry));
+  }
+  for (const auto& resource : source.resources) {
+    Append(pak, resource.second.data(), resource.second.size());
+  }
+  return pak;
+}
+
+bool IsValidPak(Bytes pak) {
+  return PakIndex(pak.data(), pak.size()).IsValid();
+}
+
+std::string GetResource(Bytes& pak, uint16_t id) {
+  ByteSpan span = PakIndex(pak.data(), pak.size()).GetResource(id);
+  return std::string((const char*)span.data(), span.size());
+}
+
+void TestLookups() {
+  PakSource source = {{{10, "ten"}, {20, "twenty"}, {30, ""}, {40, "forty"}},
+                      {{15, 1}, {35, 3}}};
+  Bytes pak = BuildPak(source);
+  EXPECT(IsValidPak(pak));
+  EXPECT(GetResource(pak, 10) == "ten");
+  EXPECT(GetResource(pak, 20) == "twenty");
+  EXPECT(GetResource(pak, 30) == "");
+  EXPECT(GetResource(pak, 40) == "forty");
+  EXPECT(GetResource(pak, 15) == "twenty");
+  EXPECT(GetResource(pak, 35) == "forty");
+  EXPECT(GetResource(pak, 25).empty());
+
+  PakIndex index(pak.data(), pak.size());
+  EXPECT(index.IsAlias(15));
+  EXPECT(!index.IsAlias(20));
+  uint32_t twenty = index.FindById(20)->file_offset;
+  EXPECT(index.FindByOffset(twenty) == index.FindById(20));
+  EXPECT(index.FindByOffset(twenty - 1) == index.FindById(10));
+  EXPECT(index.FindByOffset((uint32_t)pak.size()) == nullptr);
+}
+
+void TestRejected() {
+  PakSource good = {{{10, "ten"}, {20, "twenty"}, {30, "thirty"}},
+                    {{15, 0}, {25, 2}}};
+  EXPECT(IsValidPak(BuildPak(good)));
+
+  // Every table has to fit.
+  Bytes pak = BuildPak(good);
+  EXPECT(!IsValidPak(Bytes(pak.begin(), pak.begin() + 20)));
+  EXPECT(!IsValidPak(Bytes(pak.begin(), pak.end() - 1)));
+
+  // Resource ids have to be strictly increasing.
+  PakSource source = good;
+  std::swap(source.resources[0].first, source.resources[1].first);
+  EXPECT(!IsValidPak(BuildPak(source)));
+  source = good;
+  source.resources[1].first = 10;
+  EXPECT(!IsValidPak(BuildPak(source)));
+
+  // So do alias ids.
+  source = good;
+  std::swap(source.aliases[0].first, source.aliases[1].first);
+  EXPECT(!IsValidPak(BuildPak(source)));
+  source = good;
+  source.aliases[1].first = 15;
+  EXPECT(!IsValidPak(BuildPak(source)));
+
+  // An alias has to point at an existing entry.
+  source = good;
+  source.aliases[1].second = 3;
+  EXPECT(!IsValidPak(BuildPak(source)));
+
+  // Offsets must not go backwards.
+  pak = BuildPak(good);
+  PAK_ENTRY* entries = (PAK_ENTRY*)(pak.data() + 4 + sizeof(PAK5_HEADER));
+  uint32_t first_offset = entries[0].file_offset;
+  entries[0].file_offset = entries[1].file_offset;
+  entries[1].file_offset = first_offset;
+  EXPECT(!IsValidPak(pak));
+}
+
+// Random text with a run of whitespace every 20 bytes. Whitespace and
+// markup bytes are left out of the text, so kMinifyHtml collapses every run
+// and nothing else.
+Bytes MakeSpacedText(std::mt19937& rng, int units) {
+  Bytes text;
+  for (int unit = 0; unit < units; ++unit) {
+    for (int i = 0; i < 20; ++i) {
+      uint8_t c;
+      do {
+        c = (uint8_t)rng();
+      } while (IsMinifySpace(c) || strchr("<>\"'=/", c));
+      text.push_back(c);
+    }
+    Append(text, "  \n  ", 5);
+  }
+  return text;
+}
+
+// The slot only fits the text once its whitespace is squeezed, which is
+// only done when the rules allow it.
+void TestSqueeze() {
+  std::mt19937 rng(20240101);
+  const Bytes text = MakeSpacedText(rng, 1000);
+  Bytes squeezed = text;
+  uint32_t squeezed_size = MinifyWhitespace(
+      squeezed.data(), (uint32_t)squeezed.size(), kMinifyHtml);
+  EXPECT(squeezed_size == 21 * 1000);
+  squeezed.resize(squeezed_size);
+
+  // Stored blocks, the gzip framing and the least padding.
+  Bytes slot(squeezed_size + 5 + 18 + 2);
+  tdefl_compressor* compressor = new tdefl_compressor;
+  size_t compress_size = 0;
+
+  Bytes data = text;
+  uint32_t size = (uint32_t)data.size();
+  EXPECT(GzipCompressIntoSlot(data.data(), size, kMinifyNone, slot.data(),
+                              slot.size(), compressor, compress_size) < 0);
+  EXPECT(size == text.size() && data == text);
+
+  size = (uint32_t)data.size();
+  EXPECT(GzipCompressIntoSlot(data.data(), size, kMinifyHtml, slot.data(),
+                              slot.size(), compressor, compress_size) >= 0);
+  EXPECT(size == squeezed_size);
+  Bytes inflated(squeezed_size);
+  tinfl_decompressor decompressor;
+  EXPECT(GzipInflate(slot.data(), slot.size(), inflated.data(),
+                     inflated.size(), &decompressor));
+  EXPECT(inflated == squeezed);
+  delete compressor;
+}
+
+// A gzip member of |text| that fills its slot with room to spare, the way
+// a patched resource is written.
+std::string GzipResource(const Bytes& text, tdefl_compressor* compressor) {
+  Bytes data = text;
+  uint32_t size = (uint32_t)data.size();
+  std::string slot(size + 1024, '\0');
+  size_t compress_size = 0;
+  GzipCompressIntoSlot(data.data(), size, kMinifyNone, (uint8_t*)&slot[0],
+                       slot.size(), compressor, compress_size);
+  return slot;
+}
+
+// Gzip resources 100 to 103 end with a needle the rule below replaces,
+// resource 104 does not and is left alone.
+Bytes BuildNeedlePak() {
+  std::mt19937 rng(20240101);
+  tdefl_compressor* compressor = new tdefl_compressor;
+  PakSource source;
+  for (uint16_t id = 100; id < 105; ++id) {
+    Bytes text = MakeSpacedText(rng, 1000 + 200 * (id - 100));
+    if (id < 104)
+      Append(text, "<needle>", 8);
+    source.resources.push_back({id, GzipResource(text, compressor)});
+  }
+  delete compressor;
+  return BuildPak(source);
+}
+
+const PakRewriter& GetNeedleRewriter() {
+  static PakRewriter* rewriter = [] {
+    PakRule rule;
+    rule.needle = "<needle>";
+    rule.replacements.push_back({"<needle>", "<n>"});
+    PakRewriter* rewriter = new PakRewriter;
+    EXPECT(rewriter->AddRule(rule));
+    rewriter->Compile();
+    return rewriter;
+  }();
+  return *rewriter;
+}
+
+std::vector<uint16_t> PatchNeedles(Bytes& buffer, const Bytes& pristine) {
+  const PakRewriter& rewriter = GetNeedleRewriter();
+  return TraversalGZIPResources(
+      buffer.data(), buffer.size(),
+      [&](uint16_t id) { return rewriter.Select(id); }, rewriter.triggers(),
+      [&](uint16_t id, uint8_t* data, uint32_t size, uint32_t& new_len,
+          MinifyMode& squeeze) {
+        return rewriter.Rewrite(id, data, size, new_len, squeeze);
+      },
+      1, pristine.data());
+}
+
+// Once the first traversal has warmed the arena pool, the next one over a
+// pak of the same shape allocates nothing.
+void TestArenaReuse() {
+  const Bytes pak = BuildNeedlePak();
+  Bytes first = pak;
+  EXPECT(PatchNeedles(first, pak).size() == 4);
+  EXPECT(GetPakArenaStats().allocations > 0);
+
+  pak_arena_allocations = 0;
+  pak_arena_allocated_bytes = 0;
+  Bytes second = pak;
+  EXPECT(PatchNeedles(second, pak).size() == 4);
+  EXPECT(second == first);
+  EXPECT(GetPakArenaStats().allocations == 0);
+  EXPECT(GetPakArenaStats().allocated_bytes == 0);
+}
+
+bool IsCacheFor(const Bytes& sidecar, const PakKey& key) {
+  size_t tail = (std::min)(sidecar.size(), sizeof(PakCacheTrailer));
+  return IsPakCacheFor(sidecar.size(), sidecar.data() + sidecar.size() - tail,
+                       tail, key);
+}
+
+// A sidecar written from the original pak and the patched slots is the
+// patched pak followed by the trailer, and only matches its own key.
+void TestPakCache() {
+  const Bytes pak = BuildNeedlePak();
+  Bytes patched = pak;
+  std::vector<uint16_t> ids = PatchNeedles(patched, pak);
+  EXPECT(ids.size() == 4);
+
+  std::vector<PakPatchedSlot> slots =
+      CopyPatchedSlots(patched.data(), patched.size(), ids);
+  EXPECT(slots.size() == ids.size());
+  PakKey key = {pak.size(), 0x01D9A1B2C3D4E5F6ull,
+                HashPakTables((uint8_t*)pak.data(), pak.size()),
+                GetNeedleRewriter().Hash()};
+  Bytes sidecar;
+  auto append = [&](const void* data, size_t size) {
+    Append(sidecar, data, size);
+    return true;
+  };
+  EXPECT(WritePakCache(pak.data(), pak.size(), slots, key, append));
+  EXPECT(sidecar.size() == pak.size() + sizeof(PakCacheTrailer));
+  EXPECT(Bytes(sidecar.begin(), sidecar.begin() + pak.size()) == patched);
+  EXPECT(IsCacheFor(sidecar, key));
+
+  // Any other key, like new rules or another Chrome build.
+  PakKey other = key;
+  other.rules_hash ^= 1;
+  EXPECT(!IsCacheFor(sidecar, other));
+  other = key;
+  other.mtime += 1;
+  EXPECT(!IsCacheFor(sidecar, other));
+
+  // A size that does not fit the key, or a trailer cut short.
+  Bytes longer = sidecar;
+  longer.push_back(0);
+  EXPECT(!IsCacheFor(longer, key));
+  Bytes truncated(sidecar.begin(), sidecar.end() - 1);
+  EXPECT(!IsCacheFor(truncated, key));
+  EXPECT(!IsPakCacheFor(sidecar.size(), sidecar.data() + pak.size(),
+                        sizeof(PakCacheTrailer) - 1, key));
+  EXPECT(!IsCacheFor(pak, key));
+
+  Bytes bad_magic = sidecar;
+  bad_magic[pak.size() + sizeof(PakKey)] ^= 1;
+  EXPECT(!IsCacheFor(bad_magic, key));
+
+  // A failed write stops the cache.
+  int writes = 0;
+  EXPECT(!WritePakCache(pak.data(), pak.size(), slots, key,
+                        [&](const void*, size_t) { return ++writes < 3; }));
+  EXPECT(writes == 3);
+}
+
+// The dll and pakutil resolve the rules of a pak the same way, so a sidecar
+// from pakutil carries the key the dll looks for, overlapping patterns
+// included.
+void TestPakKey() {
+  IniFile ini;
+  ini.Parse(
+      "[pak_patch.all]\n"
+      "file=*.pak\n"
+      "ids=1\n"
+      "search1=a\n"
+      "replace1=b\n"
+      "[pak_patch.builtin_too]\n"
+      "file=resources.pak\n"
+      "ids=2\n"
+      "search1=c\n"
+      "replace1=d\n");
+  PakRuleSet rules;
+  rules.AddBuiltinRules();
+  EXPECT(rules.AddIniFile(ini).empty());
+
+  Bytes pak = BuildNeedlePak();
+  const uint64_t mtime = 0x01D9A1B2C3D4E5F6ull;
+  // MyCreateFile lower cases the path and uses backslashes, pakutil takes
+  // it from the command line.
+  PakRewriter dll;
+  EXPECT(rules.BuildRewriter(L"c:\\chrome\\app\\resources.pak", dll));
+  PakRewriter tool;
+  EXPECT(rules.BuildRewriter(Utf8ToWide("C:/Chrome/App/Resources.pak"), tool));
+  EXPECT(dll.size() == 3);
+  PakKey dll_key = MakePakKey(pak.data(), pak.size(), mtime, dll);
+  PakKey tool_key = MakePakKey(pak.data(), pak.size(), mtime, tool);
+  EXPECT(memcmp(&dll_key, &tool_key, sizeof(PakKey)) == 0);
+  EXPECT(dll_key.size == pak.size() && dll_key.mtime == mtime);
+  EXPECT(dll_key.tables_hash == HashPakTables(pak.data(), pak.size()));
+
+  // The key covers every matching rule, not only the first one.
+  PakRewriter first;
+  first.AddRule(GetBuiltinPakRule());
+  first.Compile();
+  EXPECT(MakePakKey(pak.data(), pak.size(), mtime, first).rules_hash !=
+         dll_key.rules_hash);
+}
+
+int main() {
+  TestLookups();
+  TestRejected();
+  TestSqueeze();
+  TestArenaReuse();
+  TestPakCache();
+  TestPakKey();
+  return TestResult();
+}
@@ -0,0 +1,286 @@
+// Checks how the declarative pak rules of pakrules.h are read, matched to
+// pak files and applied to resources.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "pakrules.h"
+#include "testing.h"
+
+struct RewriteResult {
+  bool changed;
+  std::string text;
+  MinifyMode squeeze;
+};
+
+// Rewrite |text| as resource |id|. The result has to fit the original size.
+RewriteResult Apply(const PakRewriter& rewriter,
+                    uint16_t id,
+                    const std::string& text) {
+  std::string buffer = text;
+  uint32_t new_len = 0;
+  MinifyMode squeeze = kMinifyNone;
+  bool changed = rewriter.Rewrite(id, (uint8_t*)&buffer[0],
+                                  (uint32_t)buffer.size(), new_len, squeeze);
+  return {changed, changed ? buffer.substr(0, new_len) : text, squeeze};
+}
+
+PakRule MakeRule(std::vector<uint16_t> ids,
+                 std::string needle,
+                 std::vector<std::pair<std::string, std::string>> pairs,
+                 MinifyMode minify = kMinifyNone) {
+  PakRule rule;
+  rule.ids = ids;
+  rule.needle = needle;
+  rule.replacements = pairs;
+  rule.minify = minify;
+  return rule;
+}
+
+// The leftmost match wins, then the longer search string, then the earlier
+// rule; matches never overlap.
+void TestReplace() {
+  PakRewriter rewriter;
+  EXPECT(rewriter.AddRule(MakeRule({1}, "", {{"abc", "X"}, {"ab", "1"}})));
+  EXPECT(rewriter.AddRule(
+      MakeRule({1}, "", {{"abcd", "Y"}, {"cd", "Z"}, {"bc", "W"}})));
+  EXPECT(rewriter.AddRule(MakeRule({1}, "", {{"ab", "2"}})));
+  rewriter.Compile();
+
+  RewriteResult result = Apply(rewriter, 1, "abcd abc cd ab");
+  EXPECT(result.changed);
+  EXPECT(result.text == "Y X Z 1");
+  EXPECT(result.squeeze == kMinifyNone);
+
+  // Replacements may shrink or grow as long as the whole result fits.
+  PakRewriter sizes;
+  EXPECT(sizes.AddRule(MakeRule({1}, "", {{"a", "aaa"}, {"bbbb", ""}})));
+  sizes.Compile();
+  EXPECT(Apply(sizes, 1, "abbbba").text == "aaaaaa");
+  EXPECT(!Apply(sizes, 1, "abbba").changed);
+
+  // Nothing found, nothing changed.
+  EXPECT(!Apply(rewriter, 1, "xyz").changed);
+}
+
+void TestSelect() {
+  PakRewriter rewriter;
+  EXPECT(rewriter.AddRule(MakeRule({5, 7}, "", {{"a", "b"}})));
+  EXPECT(rewriter.AddRule(MakeRule({9}, "<n>", {{"a", "c"}})));
+  rewriter.Compile();
+  EXPECT(rewriter.Select(5) == kPakPatch);
+  EXPECT(rewriter.Select(7) == kPakPatch);
+  EXPECT(rewriter.Select(9) == kPakScan);
+  EXPECT(rewriter.Select(6) == kPakSkip);
+
+  EXPECT(Apply(rewriter, 5, "a").text == "b");
+  EXPECT(!Apply(rewriter, 6, "a").changed);
+  // A needle rule only applies when its needle is there.
+  EXPECT(!Apply(rewriter, 9, "a").changed);
+  EXPECT(Apply(rewriter, 9, "a<n>").text == "c<n>");
+  EXPECT(rewriter.triggers().size() == 1);
+
+  PakRewriter any;
+  EXPECT(any.AddRule(MakeRule({}, "<n>", {{"a", "b"}})));
+  any.Compile();
+  EXPECT(any.Select(1) == kPakScan);
+  EXPECT(any.Select(65535) == kPakScan);
+
+  // Rules that select nothing or do nothing are refused.
+  PakRewriter refused;
+  EXPECT(!refused.AddRule(MakeRule({}, "", {{"a", "b"}})));
+  EXPECT(!refused.AddRule(MakeRule({1}, "", {})));
+  EXPECT(!refused.AddRule(MakeRule({1}, "", {{"", "b"}})));
+  EXPECT(refused.AddRule(MakeRule({1}, "", {}, kMinifyLines)));
+  EXPECT(refused.size() == 1);
+}
+
+// The needle sees the text as it is, the search strings see it minified.
+void TestMinifyFirst() {
+  PakRewriter rewriter;
+  EXPECT(rewriter.AddRule(
+      MakeRule({}, "a   b", {{"a b", "ab"}}, kMinifyCollapse)));
+  rewriter.Compile();
+  RewriteResult result = Apply(rewriter, 1, "x  a   b  y");
+  EXPECT(result.changed);
+  EXPECT(result.text == "x ab y");
+  EXPECT(result.squeeze == kMinifyHtml);
+
+  // Minifying alone is a change.
+  PakRewriter minify;
+  EXPECT(minify.AddRule(MakeRule({1}, "", {}, kMinifyLines)));
+  minify.Compile();
+  EXPECT(Apply(minify, 1, "  a  \n  b  ").text == "a\nb");
+  EXPECT(!Apply(minify, 1, "a\nb").changed);
+
+  // The later minify mode wins when several rules apply.
+  PakRewriter both;
+  EXPECT(both.AddRule(MakeRule({1}, "", {}, kMinifyLines)));
+  EXPECT(both.AddRule(MakeRule({1}, "", {}, kMinifyCollapse)));
+  both.Compile();
+  EXPECT(Apply(both, 1, "a  \n  b c").text == "a\nb c");
+  EXPECT(Apply(both, 1, "a   b").text == "a b");
+}
+
+void TestUnescape() {
+  EXPECT(UnescapeRuleString("") == "");
+  EXPECT(UnescapeRuleString("plain") == "plain");
+  EXPECT(UnescapeRuleString("a\\nb\\tc") == "a\nb\tc");
+  EXPECT(UnescapeRuleString("a\\\\nb") == "a\\nb");
+  // Other escapes keep the character, a trailing backslash stays.
+  EXPECT(UnescapeRuleString("\\q\\\"") == "q\"");
+  EXPECT(UnescapeRuleString("end\\") == "end\\");
+}
+
+void TestMatchPakFile() {
+  auto match = [](const char* pattern, const char* path) {
+    return MatchPakFile(std::string(pattern), std::string(path));
+  };
+  EXPECT(match("resources.pak", "C:\\Chrome\\App\\resources.pak"));
+  EXPECT(match("resources.pak", "C:\\Chrome\\App\\Resources.PAK"));
+  EXPECT(match("resources.pak", "resources.pak"));
+  EXPECT(!match("resources.pak", "C:\\Chrome\\App\\resources.pak.bak"));
+  EXPECT(!match("resources.pak", "C:\\Chrome\\App\\my_resources.pak"));
+
+  // Either slash in the pattern and the path.
+  EXPECT(match("locales/*.pak", "C:\\Chrome\\locales\\en-US.pak"));
+  EXPECT(match("locales\\*.pak", "C:/Chrome/locales/en-US.pak"));
+  EXPECT(match("Locales/EN-us.pak", "C:\\Chrome\\locales\\en-US.pak"));
+  EXPECT(!match("locales/*.pak", "C:\\Chrome\\en-US.pak"));
+  EXPECT(!match("locales/*.pak", "en-US.pak"));
+
+  // A star stays within one component.
+  EXPECT(match("*.pak", "C:\\Chrome\\locales\\en-US.pak"));
+  EXPECT(match("l*s/*-US.pak", "C:\\Chrome\\locales\\en-US.pak"));
+  EXPECT(!match("*/en-US.pak", "en-US.pak"));
+  EXPECT(!match("*-US.pak", "C:\\Chrome\\en-GB.pak"));
+  EXPECT(match("*a*a*.pak", "C:\\banana.pak"));
+
+  EXPECT(MatchPakFile(std::wstring(L"locales/*.pak"),
+                      std::wstring(L"C:\\Chrome\\LOCALES\\zh-CN.pak")));
+}
+
+void TestReadPakRule() {
+  IniFile ini;
+  ini.Parse(
+      "[general]\n"
+      "x=1\n"
+      "[pak_patch.one]\n"
+      "ids=12345, 7,70000,0,x\n"
+      "needle=<a>\\n\n"
+      "minify=html\n"
+      "search1=a\\tb\n"
+      "replace1=\"c\"\n"
+      "search2=d\n"
+      "search4=skipped\n"
+      "[pak_patch.two]\n"
+      "file=locales/*.pak\n"
+      "minify=1\n");
+
+  PakRule rule;
+  std::string file;
+  EXPECT(!ReadPakRule(ini.sections()[0], rule, file));
+
+  EXPECT(ReadPakRule(ini.sections()[1], rule, file));
+  EXPECT(file == kPakDefaultFile);
+  EXPECT(rule.ids == std::vector<uint16_t>({12345, 7}));
+  EXPECT(rule.needle == "<a>\n");
+  EXPECT(rule.minify == kMinifyHtml);
+  EXPECT(rule.replacements.size() == 2);
+  EXPECT(rule.replacements[0].first == "a\tb");
+  EXPECT(rule.replacements[0].second == "c");
+  EXPECT(rule.replacements[1].first == "d");
+  EXPECT(rule.replacements[1].second == "");
+
+  PakRule two;
+  EXPECT(ReadPakRule(ini.sections()[2], two, file));
+  EXPECT(file == "locales/*.pak");
+  EXPECT(two.minify == kMinifyLines);
+  EXPECT(two.replacements.empty());
+
+  EXPECT(ParseMinifyMode("collapse") == kMinifyCollapse);
+  EXPECT(ParseMinifyMode("0") == kMinifyNone);
+  EXPECT(ParseMinifyMode("") == kMinifyNone);
+}
+
+// A pak gets every rule whose pattern matches it, in the order they were
+// read, even when several patterns match.
+void TestRuleSet() {
+  IniFile ini;
+  ini.Parse(
+      "[pak_patch.a]\n"
+      "file=locales/en-US.pak\n"
+      "ids=1\n"
+      "search1=a\n"
+      "replace1=b\n"
+      "[pak_patch.b]\n"
+      "file=locales/*.pak\n"
+      "ids=1\n"
+      "search1=b\n"
+      "replace1=c\n"
+      "[pak_patch.c]\n"
+      "file=*.pak\n"
+      "ids=1\n"
+      "search1=x\n"
+      "replace1=y\n"
+      "[pak_patch.bad]\n"
+      "file=*.pak\n"
+      "ids=1\n");
+  PakRuleSet rules;
+  rules.AddBuiltinRules();
+  EXPECT(rules.AddIniFile(ini) == std::vector<std::string>({"pak_patch.bad"}));
+  PakRule a = MakeRule({1}, "", {{"a", "b"}});
+  PakRule b = MakeRule({1}, "", {{"b", "c"}});
+  PakRule c = MakeRule({1}, "", {{"x", "y"}});
+
+  const std::wstring en_us = L"c:\\chrome\\locales\\en-us.pak";
+  PakRewriter merged;
+  EXPECT(rules.BuildRewriter(en_us, merged));
+  EXPECT(merged.size() == 3);
+  PakRewriter expected;
+  expected.AddRule(a);
+  expected.AddRule(b);
+  expected.AddRule(c);
+  expected.Compile();
+  EXPECT(merged.Hash() == expected.Hash());
+  // Each of the three rules applies.
+  EXPECT(Apply(merged, 1, "ab x").text == "bc y");
+
+  // The built-in resources.pak rule and the user *.pak rule together.
+  PakRewriter resources;
+  EXPECT(rules.BuildRewriter(L"c:\\chrome\\resources.pak", resources));
+  PakRewriter builtin;
+  builtin.AddRule(GetBuiltinPakRule());
+  builtin.AddRule(c);
+  builtin.Compile();
+  EXPECT(resources.size() == 2);
+  EXPECT(resources.Hash() == builtin.Hash());
+
+  PakRewriter none;
+  EXPECT(!rules.BuildRewriter(L"c:\\chrome\\readme.txt", none));
+  EXPECT(!rules.Matches(L"c:\\chrome\\readme.txt"));
+  EXPECT(rules.Matches(L"c:\\chrome\\chrome_100_percent.pak"));
+  EXPECT(rules.HasWildcard());
+  EXPECT(rules.GetNamedPatterns() ==
+         std::vector<std::wstring>({L"resources.pak", L"locales\\en-us.pak"}));
+
+  PakRuleSet builtin_only;
+  builtin_only.AddBuiltinRules();
+  EXPECT(!builtin_only.HasWildcard());
+  EXPECT(!builtin_only.Matches(en_us));
+}
+
+int main() {
+  TestReplace();
+  TestSelect();
+  TestMinifyFirst();
+  TestUnescape();
+  TestMatchPakFile();
+  TestReadPakRule();
+  TestRuleSet();
+  return TestResult();
+}
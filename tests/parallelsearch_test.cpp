@@ -0,0 +1,91 @@
+// Checks that ParallelSearch returns the same match as FastSearch at every
+// thread count, also when several searches run at once.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "parallelsearch.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+const int kSize = kParallelSearchMinSize + 3 * kParallelSearchBlockSize / 2;
+
+int Search(const Bytes& s, const Bytes& p, unsigned threads) {
+  const uint8_t* match = ParallelSearch(s.data(), (int)s.size(), p.data(),
+                                        (int)p.size(), threads);
+  return match ? (int)(match - s.data()) : -1;
+}
+
+void TestMatches(Bytes& s, const Bytes& p) {
+  const int m = (int)p.size();
+  // No match, then matches on block edges and at both ends. A later copy
+  // must not win over an earlier one found by a slower thread.
+  std::vector<std::vector<int>> placements = {
+      {},
+      {0},
+      {kSize - m},
+      {kParallelSearchBlockSize - 1},
+      {kParallelSearchBlockSize - m + 1},
+      {3 * kParallelSearchBlockSize - 2, 5 * kParallelSearchBlockSize},
+      {kParallelSearchBlockSize / 2, kSize - m},
+  };
+  for (const auto& offsets : placements) {
+    for (int offset : offsets) {
+      std::copy(p.begin(), p.end(), s.begin() + offset);
+    }
+    int expected = offsets.empty() ? -1 : offsets[0];
+    for (unsigned threads : {0u, 1u, 2u, 3u, 4u, 8u}) {
+      int found = Search(s, p, threads);
+      if (found != expected) {
+        fprintf(stderr, "m=%d threads=%u found %d expected %d\n", m, threads,
+                found, expected);
+        ++test_failures;
+      }
+    }
+    for (int offset : offsets) {
+      std::fill(s.begin() + offset, s.begin() + offset + m, 'x');
+    }
+  }
+}
+
+// Searches started from several threads share the pool, those that find it
+// busy run on their own thread.
+void TestConcurrent(const Bytes& s, const Bytes& p) {
+  std::vector<std::thread> callers;
+  std::vector<int> found(6);
+  for (size_t i = 0; i < found.size(); ++i) {
+    callers.emplace_back([&, i] {
+      for (int round = 0; round < 4; ++round) {
+        found[i] = Search(s, p, 4);
+      }
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  for (int offset : found) {
+    EXPECT(offset == kSize - (int)p.size());
+  }
+}
+
+int main() {
+  std::mt19937 rng(20240101);
+  Bytes s(kSize, 'x');
+  for (int m : {1, 7, 64}) {
+    Bytes p(m);
+    for (auto& c : p) {
+      c = (uint8_t)('a' + rng() % 8);
+    }
+    TestMatches(s, p);
+  }
+
+  Bytes p = {'n', 'e', 'e', 'd', 'l', 'e'};
+  std::copy(p.begin(), p.end(), s.end() - p.size());
+  TestConcurrent(s, p);
+  return TestResult();
+}
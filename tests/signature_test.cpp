@@ -0,0 +1,197 @@
+// Matches wildcard signatures against the sections of a PE-like buffer.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "peimage.h"
+#include "signature.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+const uint32_t kTextOffset = 0x400;
+const uint32_t kTextSize = 0x2000;
+const uint32_t kRdataOffset = kTextOffset + kTextSize;
+const uint32_t kRdataSize = 0x1000;
+
+void Write16(Bytes& image, size_t offset, uint16_t value) {
+  memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+void Write32(Bytes& image, size_t offset, uint32_t value) {
+  memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+// A DOS header, the PE signature, a file header, an optional header left
+// zeroed and a .text and .rdata section filled with random bytes.
+Bytes MakeImage(std::mt19937& rng) {
+  Bytes image(kRdataOffset + kRdataSize);
+  for (size_t i = kTextOffset; i < image.size(); ++i) {
+    image[i] = (uint8_t)rng();
+  }
+
+  const size_t nt_offset = 0x80;
+  const uint16_t optional_header_size = 0xF0;
+  Write16(image, 0, 0x5A4D);
+  Write32(image, 0x3C, nt_offset);
+  Write32(image, nt_offset, 0x00004550);
+  Write16(image, nt_offset + 4 + 2, 2);
+  Write16(image, nt_offset + 4 + 16, optional_header_size);
+
+  size_t section = nt_offset + 4 + 20 + optional_header_size;
+  memcpy(image.data() + section, ".text", 5);
+  Write32(image, section + 16, kTextSize);
+  Write32(image, section + 20, kTextOffset);
+  section += 40;
+  memcpy(image.data() + section, ".rdata", 6);
+  Write32(image, section + 16, kRdataSize);
+  Write32(image, section + 20, kRdataOffset);
+  return image;
+}
+
+void Put(Bytes& image, size_t offset, const Bytes& bytes) {
+  std::copy(bytes.begin(), bytes.end(), image.begin() + offset);
+}
+
+int SearchSection(Bytes& image, const char* name, const Signature& signature) {
+  PeSection section;
+  if (!FindPeSection(image.data(), image.size(), name, section))
+    return -2;
+  const uint8_t* match = signature.Search(section.data, section.size);
+  return match ? (int)(match - image.data()) : -1;
+}
+
+void TestSections(std::mt19937& rng) {
+  Bytes image = MakeImage(rng);
+  PeSection section;
+  EXPECT(FindPeSection(image.data(), image.size(), ".text", section));
+  EXPECT(section.data == image.data() + kTextOffset);
+  EXPECT(section.size == (int)kTextSize);
+  EXPECT(FindPeSection(image.data(), image.size(), ".rdata", section));
+  EXPECT(section.data == image.data() + kRdataOffset);
+  EXPECT(!FindPeSection(image.data(), image.size(), ".data", section));
+
+  // The .rdata raw data does not fit a truncated file.
+  EXPECT(!FindPeSection(image.data(), image.size() - 1, ".rdata", section));
+  EXPECT(FindPeSection(image.data(), image.size() - 1, ".text", section));
+  EXPECT(!FindPeSection(image.data(), 0x100, ".text", section));
+
+  Bytes not_pe = image;
+  not_pe[0] = 0;
+  EXPECT(!FindPeSection(not_pe.data(), not_pe.size(), ".text", section));
+}
+
+void TestParse() {
+  Signature signature("48 89 8C 24 ?? ?? 00 00 80 3D");
+  EXPECT(signature.IsValid());
+  EXPECT(signature.size() == 10);
+  EXPECT(signature.anchor_offset() == 0);
+  EXPECT(signature.anchor_length() == 4);
+
+  Signature tail("?? 01 ? 02 03 04 ??");
+  EXPECT(tail.IsValid());
+  EXPECT(tail.size() == 7);
+  EXPECT(tail.anchor_offset() == 3);
+  EXPECT(tail.anchor_length() == 3);
+
+  EXPECT(!Signature("").IsValid());
+  EXPECT(!Signature("4").IsValid());
+  EXPECT(!Signature("48 8").IsValid());
+  EXPECT(!Signature("GG").IsValid());
+  EXPECT(!Signature("488B").IsValid());
+  EXPECT(!Signature("48 ??? 8B").IsValid());
+}
+
+void TestSearch(std::mt19937& rng) {
+  const Signature signature("48 89 8C 24 ?? ?? 00 00 80 3D");
+  const Bytes first = {0x48, 0x89, 0x8C, 0x24, 0x12, 0x34,
+                       0x00, 0x00, 0x80, 0x3D};
+  const Bytes second = {0x48, 0x89, 0x8C, 0x24, 0xAB, 0xCD,
+                        0x00, 0x00, 0x80, 0x3D};
+  // The anchor matches, a fixed byte after the wildcards does not.
+  const Bytes decoy = {0x48, 0x89, 0x8C, 0x24, 0x12, 0x34,
+                       0x00, 0x01, 0x80, 0x3D};
+
+  Bytes image = MakeImage(rng);
+  EXPECT(SearchSection(image, ".text", signature) == -1);
+
+  Put(image, kTextOffset + 0x100, decoy);
+  EXPECT(SearchSection(image, ".text", signature) == -1);
+
+  // Any bytes under the wildcards, the leftmost match wins.
+  Put(image, kTextOffset + 0x900, second);
+  Put(image, kTextOffset + 0x500, first);
+  EXPECT(SearchSection(image, ".text", signature) == (int)kTextOffset + 0x500);
+
+  // Only the section asked for is searched.
+  EXPECT(SearchSection(image, ".rdata", signature) == -1);
+  Put(image, kRdataOffset + 0x20, second);
+  EXPECT(SearchSection(image, ".rdata", signature) ==
+         (int)kRdataOffset + 0x20);
+
+  // A match that ends on the last byte of the section is found, one that
+  // runs into the next section is not.
+  Bytes edge = MakeImage(rng);
+  Put(edge, kRdataOffset - first.size(), first);
+  EXPECT(SearchSection(edge, ".text", signature) ==
+         (int)(kRdataOffset - first.size()));
+  edge = MakeImage(rng);
+  Put(edge, kRdataOffset - first.size() + 1, first);
+  EXPECT(SearchSection(edge, ".text", signature) == -1);
+}
+
+// Random patterns with wildcards against a naive masked compare.
+void TestRandom(std::mt19937& rng) {
+  for (int round = 0; round < 2000; ++round) {
+    Bytes data(64 + rng() % 400);
+    for (auto& c : data) {
+      c = (uint8_t)(rng() % 4);
+    }
+
+    int size = 1 + rng() % 24;
+    std::string pattern;
+    Bytes bytes(size);
+    Bytes mask(size);
+    for (int i = 0; i < size; ++i) {
+      mask[i] = rng() % 3 ? 0xFF : 0;
+      bytes[i] = (uint8_t)(rng() % 4);
+      char token[4];
+      snprintf(token, sizeof(token), "%02X", bytes[i]);
+      pattern += i ? " " : "";
+      pattern += mask[i] ? token : "??";
+    }
+
+    int expected = -1;
+    for (int i = 0; expected < 0 && i + size <= (int)data.size(); ++i) {
+      int k = 0;
+      while (k < size && !((data[i + k] ^ bytes[k]) & mask[k])) {
+        ++k;
+      }
+      if (k == size)
+        expected = i;
+    }
+
+    Signature signature(pattern.c_str());
+    const uint8_t* match = signature.Search(data.data(), (int)data.size());
+    int found = match ? (int)(match - data.data()) : -1;
+    if (found != expected) {
+      fprintf(stderr, "\"%s\": found %d expected %d\n", pattern.c_str(),
+              found, expected);
+      ++test_failures;
+    }
+  }
+}
+
+int main() {
+  std::mt19937 rng(20240101);
+  TestSections(rng);
+  TestParse();
+  TestSearch(rng);
+  TestRandom(rng);
+  return TestResult();
+}
@@ -0,0 +1,166 @@
+// Feeds streams to StreamSearcher in random chunks and compares the matches
+// with a naive search over the whole stream.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "streamsearch.h"
+#include "testing.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Every start of |p| in |s|, overlapping ones included.
+std::vector<uint64_t> NaiveOffsets(const Bytes& s, const Bytes& p) {
+  std::vector<uint64_t> offsets;
+  for (size_t i = 0; i + p.size() <= s.size(); ++i) {
+    if (memcmp(s.data() + i, p.data(), p.size()) == 0)
+      offsets.push_back(i);
+  }
+  return offsets;
+}
+
+// Feed |s| in chunks of the given sizes, the last one takes the rest.
+std::vector<uint64_t> Feed(StreamSearcher& searcher,
+                           const Bytes& s,
+                           const std::vector<int>& sizes) {
+  std::vector<uint64_t> offsets;
+  auto collect = [&](uint64_t offset) {
+    offsets.push_back(offset);
+    return true;
+  };
+  size_t at = 0;
+  for (int size : sizes) {
+    size = (int)(std::min)((size_t)size, s.size() - at);
+    EXPECT(searcher.Feed(s.data() + at, size, collect));
+    at += size;
+  }
+  EXPECT(searcher.Feed(s.data() + at, (int)(s.size() - at), collect));
+  EXPECT(searcher.offset() == s.size());
+  return offsets;
+}
+
+Bytes ToBytes(const std::string& text) {
+  return Bytes(text.begin(), text.end());
+}
+
+void TestStraddling() {
+  const Bytes p = ToBytes("needle");
+  const Bytes s = ToBytes("xxneedlexneedleneedlexx");
+  const std::vector<uint64_t> expected = {2, 9, 15};
+  StreamSearcher searcher(p.data(), (int)p.size());
+
+  // Every split point, including inside each match.
+  for (int split = 0; split <= (int)s.size(); ++split) {
+    searcher.Reset();
+    EXPECT(Feed(searcher, s, {split}) == expected);
+  }
+  // One byte at a time, empty chunks in between.
+  searcher.Reset();
+  EXPECT(Feed(searcher, s, std::vector<int>(s.size(), 1)) == expected);
+  searcher.Reset();
+  EXPECT(Feed(searcher, s, {0, 3, 0, 1, 0, 5, 0}) == expected);
+}
+
+// Overlapping matches of a periodic needle across chunk edges.
+void TestOverlapping() {
+  const Bytes p = ToBytes("aaa");
+  const Bytes s = ToBytes("aaaaaa");
+  StreamSearcher searcher(p.data(), (int)p.size());
+  EXPECT(Feed(searcher, s, {1, 1, 1, 1, 1}) ==
+         std::vector<uint64_t>({0, 1, 2, 3}));
+  searcher.Reset();
+  EXPECT(Feed(searcher, s, {2, 2}) == std::vector<uint64_t>({0, 1, 2, 3}));
+}
+
+// Reset drops the carried tail and the offset.
+void TestReset() {
+  const Bytes p = ToBytes("abc");
+  StreamSearcher searcher(p.data(), (int)p.size());
+  auto never = [](uint64_t) {
+    ++test_failures;
+    return true;
+  };
+  EXPECT(searcher.Feed((const uint8_t*)"xab", 3, never));
+  EXPECT(searcher.offset() == 3);
+  searcher.Reset();
+  EXPECT(searcher.offset() == 0);
+  // "ab" + "c" would match without the reset.
+  EXPECT(searcher.Feed((const uint8_t*)"cxx", 3, never));
+
+  std::vector<uint64_t> offsets;
+  EXPECT(searcher.Feed((const uint8_t*)"xabc", 4, [&](uint64_t offset) {
+    offsets.push_back(offset);
+    return true;
+  }));
+  EXPECT(offsets == std::vector<uint64_t>({4}));
+}
+
+// Returning false stops this chunk and every later one until a reset.
+void TestStop() {
+  const Bytes p = ToBytes("ab");
+  const Bytes s = ToBytes("abxabxab");
+  StreamSearcher searcher(p.data(), (int)p.size());
+  // The stream has 3 matches, 4 never stops.
+  for (int stop_after : {1, 2, 3, 4}) {
+    // Straddling chunks, so a stop can come from the carried tail.
+    for (int chunk : {1, 2, 4}) {
+      searcher.Reset();
+      std::vector<uint64_t> offsets;
+      auto stop = [&](uint64_t offset) {
+        offsets.push_back(offset);
+        return (int)offsets.size() < stop_after;
+      };
+      bool running = true;
+      for (size_t at = 0; at < s.size() && running; at += chunk) {
+        running = searcher.Feed(s.data() + at, chunk, stop);
+      }
+      bool all = stop_after == 4;
+      EXPECT(offsets.size() == (size_t)(std::min)(stop_after, 3));
+      EXPECT(searcher.stopped() == !all);
+      EXPECT(running == all);
+      if (!all) {
+        EXPECT(!searcher.Feed(s.data(), (int)s.size(), stop));
+        EXPECT(offsets.size() == (size_t)stop_after);
+      }
+    }
+  }
+}
+
+// Random needles and streams over small alphabets in random chunks.
+void TestRandom() {
+  std::mt19937 rng(20240101);
+  for (int round = 0; round < 3000; ++round) {
+    int alphabet = 2 + rng() % 3;
+    Bytes p(1 + rng() % 12);
+    for (auto& c : p) {
+      c = (uint8_t)('a' + rng() % alphabet);
+    }
+    Bytes s(rng() % 200);
+    for (auto& c : s) {
+      c = (uint8_t)('a' + rng() % alphabet);
+    }
+    std::vector<int> sizes(rng() % 20);
+    for (auto& size : sizes) {
+      size = rng() % 3 ? rng() % (p.size() + 2) : rng() % 40;
+    }
+    StreamSearcher searcher(p.data(), (int)p.size());
+    if (Feed(searcher, s, sizes) != NaiveOffsets(s, p)) {
+      fprintf(stderr, "round %d: m=%zu n=%zu\n", round, p.size(), s.size());
+      ++test_failures;
+    }
+  }
+}
+
+int main() {
+  TestStraddling();
+  TestOverlapping();
+  TestReset();
+  TestStop();
+  TestRandom();
+  return TestResult();
+}
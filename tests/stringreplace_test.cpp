@@ -0,0 +1,277 @@
+// Checks ReplaceAll of stringreplace.h in each of its write modes against
+// the ReplaceStringInPlace loop utils.h used and a naive scan.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "stringreplace.h"
+#include "testing.h"
+
+typedef std::vector<std::pair<std::string, std::string>> Pairs;
+
+// The replacement loop utils.h used, one call per search string.
+template <typename Char>
+bool ReplaceStringInPlace(std::basic_string<Char>& subject,
+                          const std::basic_string<Char>& search,
+                          const std::basic_string<Char>& replace) {
+  bool find = false;
+  size_t pos = 0;
+  while ((pos = subject.find(search, pos)) != std::basic_string<Char>::npos) {
+    subject.replace(pos, search.length(), replace);
+    pos += replace.length();
+    find = true;
+  }
+  return find;
+}
+
+// The leftmost match, then the longer search string, then the earlier pair,
+// one position at a time.
+std::string NaiveReplaceAll(const std::string& subject, const Pairs& pairs) {
+  std::string result;
+  size_t pos = 0;
+  while (pos < subject.size()) {
+    const std::pair<std::string, std::string>* best = nullptr;
+    for (const auto& pair : pairs) {
+      if (!pair.first.empty() &&
+          subject.compare(pos, pair.first.size(), pair.first) == 0 &&
+          (!best || pair.first.size() > best->first.size()))
+        best = &pair;
+    }
+    if (best) {
+      result += best->second;
+      pos += best->first.size();
+    } else {
+      result += subject[pos++];
+    }
+  }
+  return result;
+}
+
+std::vector<ReplacePair<char>> ToPairs(const Pairs& pairs) {
+  std::vector<ReplacePair<char>> views;
+  for (const auto& pair : pairs) {
+    views.emplace_back(pair.first, pair.second);
+  }
+  return views;
+}
+
+// ReplaceAll in place, and into a buffer of exactly the result size.
+std::string Replace(const std::string& subject,
+                    const Pairs& pairs,
+                    bool* changed = nullptr) {
+  std::vector<ReplacePair<char>> views = ToPairs(pairs);
+  std::string in_place = subject;
+  bool matched = ReplaceAll(in_place, views.data(), views.size());
+  if (changed)
+    *changed = matched;
+
+  std::string_view view(subject);
+  size_t size = ReplaceAllSize(view, views.data(), views.size());
+  EXPECT(size == in_place.size());
+  std::string buffer(size, '\0');
+  EXPECT(ReplaceAll(view, views.data(), views.size(), &buffer[0],
+                    buffer.size()) == size);
+  EXPECT(buffer == in_place);
+  return in_place;
+}
+
+// Which way ReplaceAll wrote |subject|, told by where its data ends up.
+enum Mode { kForward, kBackward, kFresh };
+
+Mode ReplaceMode(const std::string& subject,
+                 const Pairs& pairs,
+                 std::string& result) {
+  std::vector<ReplacePair<char>> views = ToPairs(pairs);
+  result = subject;
+  // Room for any growth, so only a new buffer moves the data.
+  result.reserve(subject.size() * 8 + 64);
+  const char* data = result.data();
+  EXPECT(ReplaceAll(result, views.data(), views.size()));
+  if (result.data() != data)
+    return kFresh;
+  return result.size() <= subject.size() ? kForward : kBackward;
+}
+
+// One pair is what ReplaceStringInPlace did, growing, shrinking or removing.
+void TestSinglePair() {
+  const Pairs cases[] = {
+      {{"ab", "xyz"}},  {{"ab", "x"}},  {{"ab", ""}},   {{"ab", "ab"}},
+      {{"a", "aa"}},    {{"aa", "a"}},  {{"aba", "b"}}, {{"b", "bab"}},
+      {{"zz", "y"}},    {{"", "x"}},
+  };
+  const char* subjects[] = {"", "a", "ab", "abab", "aaaa", "xabyaba", "babab"};
+  for (const Pairs& pairs : cases) {
+    for (const char* text : subjects) {
+      std::string expected = text;
+      bool expected_changed =
+          !pairs[0].first.empty() &&
+          ReplaceStringInPlace(expected, pairs[0].first, pairs[0].second);
+      bool changed = false;
+      std::string result = Replace(text, pairs, &changed);
+      if (result != expected || changed != expected_changed) {
+        fprintf(stderr, "\"%s\" -> \"%s\" in \"%s\": \"%s\"\n",
+                pairs[0].first.c_str(), pairs[0].second.c_str(), text,
+                result.c_str());
+        ++test_failures;
+      }
+    }
+  }
+}
+
+// Chaining gives the same result as one pass when no replacement contains a
+// later search string, like the %app% expansions.
+void TestChained() {
+  const Pairs pairs = {{"%app%", "C:\\Chrome"}, {"%data%", "D"}, {"-x", ""}};
+  const std::string subject = "%app%\\User Data;%data%-x%app%%data%";
+  std::string chained = subject;
+  for (const auto& pair : pairs) {
+    ReplaceStringInPlace(chained, pair.first, pair.second);
+  }
+  EXPECT(Replace(subject, pairs) == chained);
+  EXPECT(NaiveReplaceAll(subject, pairs) == chained);
+
+  // Unlike chaining, a replacement is never searched again.
+  EXPECT(Replace("ab", {{"a", "b"}, {"b", "c"}}) == "bc");
+  // The longer search string wins a tie, the earlier pair an exact one.
+  EXPECT(Replace("abc", {{"a", "1"}, {"abc", "2"}}) == "2");
+  EXPECT(Replace("ab", {{"ab", "1"}, {"ab", "2"}}) == "1");
+}
+
+// Forward in place while the output never gets ahead of the input,
+// backward in place while it never falls behind, a fresh buffer otherwise.
+void TestModes() {
+  std::string result;
+  EXPECT(ReplaceMode("xaxbx", {{"a", ""}, {"b", "c"}}, result) == kForward);
+  EXPECT(result == "xxcx");
+  EXPECT(ReplaceMode("aXbb", {{"a", "a"}, {"bb", "b"}}, result) == kForward);
+  EXPECT(result == "aXb");
+
+  EXPECT(ReplaceMode("xaxbx", {{"a", "aaa"}, {"b", "b"}}, result) ==
+         kBackward);
+  EXPECT(result == "xaaaxbx");
+  EXPECT(ReplaceMode("abab", {{"a", "12"}, {"b", "345"}}, result) ==
+         kBackward);
+  EXPECT(result == "1234512345");
+
+  // Ahead after the first match, behind after the second.
+  EXPECT(ReplaceMode("axbbbb", {{"a", "123"}, {"bbbb", ""}}, result) ==
+         kFresh);
+  EXPECT(result == "123x");
+  // Behind, then ahead.
+  EXPECT(ReplaceMode("bxa", {{"a", "123"}, {"b", ""}}, result) == kFresh);
+  EXPECT(result == "x123");
+}
+
+// Past ReplacePlan::kKept matches the write pass searches again, and only
+// the forward and fresh modes are used.
+void TestSpill() {
+  const size_t kCount = ReplacePlan::kKept * 3 + 1;
+  std::string subject;
+  for (size_t i = 0; i < kCount; ++i) {
+    subject += "<a>" + std::to_string(i);
+  }
+  size_t matches = 0;
+  ReplaceAllSize(std::string_view(subject), ToPairs({{"<a>", ""}}).data(), 1,
+                 &matches);
+  EXPECT(matches == kCount);
+
+  const Pairs cases[] = {
+      {{"<a>", "<a>"}},                   // Same size.
+      {{"<a>", "<"}},                     // Shrinking.
+      {{"<a>", ""}},                      // Removed.
+      {{"<a>1", ""}, {"<a>2", "<b>"}},    // Shrinking, two pairs.
+      {{"<a>", "<b>12"}},                 // Growing.
+      {{"<a>1", ""}, {"<a>2", "<b>22"}},  // Mixed.
+  };
+  for (const Pairs& pairs : cases) {
+    std::string result;
+    Mode mode = ReplaceMode(subject, pairs, result);
+    EXPECT(result == NaiveReplaceAll(subject, pairs));
+    EXPECT(Replace(subject, pairs) == result);
+    bool shrinks = true;
+    for (const auto& pair : pairs) {
+      shrinks &= pair.second.size() <= pair.first.size();
+    }
+    EXPECT(mode == (shrinks ? kForward : kFresh));
+  }
+
+  // A single pair matches ReplaceStringInPlace past the spill too.
+  std::string expected = subject;
+  ReplaceStringInPlace(expected, std::string("<a>"), std::string("[link]"));
+  EXPECT(Replace(subject, {{"<a>", "[link]"}}) == expected);
+}
+
+// Nothing is written into a buffer that is too small.
+void TestBuffer() {
+  const Pairs strings = {{"a", "bb"}};
+  std::vector<ReplacePair<char>> pairs = ToPairs(strings);
+  std::string_view subject = "xax";
+  char out[8];
+  memset(out, '#', sizeof(out));
+  EXPECT(ReplaceAll(subject, pairs.data(), pairs.size(), out, 3) == 4);
+  EXPECT(std::string(out, sizeof(out)) == "########");
+  EXPECT(ReplaceAll(subject, pairs.data(), pairs.size(), out, 4) == 4);
+  EXPECT(std::string(out, sizeof(out)) == "xbbx####");
+
+  // No match copies the subject.
+  EXPECT(ReplaceAll(std::string_view("yy"), pairs.data(), pairs.size(), out,
+                    2) == 2);
+  EXPECT(std::string(out, 2) == "yy");
+}
+
+void TestWide() {
+  std::wstring path = L"%app%\\Data\\%app%";
+  EXPECT(ReplaceAll(path, {{L"%app%", L"C:\\Program Files\\Chrome"}}));
+  EXPECT(path == L"C:\\Program Files\\Chrome\\Data\\C:\\Program Files\\Chrome");
+  EXPECT(ReplaceAll(path, {{L"Program Files", L"P"}, {L"Chrome", L""}}));
+  EXPECT(path == L"C:\\P\\\\Data\\C:\\P\\");
+  EXPECT(!ReplaceAll(path, {{L"%app%", L"x"}}));
+}
+
+// Random pairs over a small alphabet, enough matches to spill at times.
+void TestRandom() {
+  std::mt19937 rng(20240101);
+  auto random_text = [&](size_t size, int alphabet) {
+    std::string text(size, 'a');
+    for (auto& c : text) {
+      c = (char)('a' + rng() % alphabet);
+    }
+    return text;
+  };
+  for (int round = 0; round < 3000; ++round) {
+    int alphabet = 2 + rng() % 3;
+    std::string subject = random_text(rng() % 300, alphabet);
+    Pairs pairs(1 + rng() % 4);
+    for (auto& pair : pairs) {
+      pair.first = random_text(rng() % 4, alphabet);
+      pair.second = random_text(rng() % 6, alphabet + 1);
+    }
+    bool any = false;
+    std::string result = Replace(subject, pairs, &any);
+    if (result != NaiveReplaceAll(subject, pairs)) {
+      fprintf(stderr, "round %d: \"%s\" became \"%s\"\n", round,
+              subject.c_str(), result.c_str());
+      ++test_failures;
+    }
+    if (!any)
+      EXPECT(result == subject);
+  }
+}
+
+int main() {
+  TestSinglePair();
+  TestChained();
+  TestModes();
+  TestSpill();
+  TestBuffer();
+  TestWide();
+  TestRandom();
+  return TestResult();
+}
@@ -0,0 +1,101 @@
+// Checks the lazy StringTokens of stringsplit.h and the function key names
+// of functionkey.h that ParseHotkeys reads from its tokens.
+
+#include <stdio.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "functionkey.h"
+#include "stringsplit.h"
+#include "testing.h"
+
+template <typename Char>
+std::vector<std::basic_string<Char>> Tokens(const StringTokens<Char>& tokens) {
+  std::vector<std::basic_string<Char>> result;
+  for (auto token : tokens) {
+    result.emplace_back(token);
+  }
+  return result;
+}
+
+typedef std::vector<std::string> Strings;
+
+void TestSplit() {
+  EXPECT(StringSplit("", ';').empty());
+  EXPECT(Tokens(StringSplit("", ';')).empty());
+  EXPECT(Tokens(StringSplit("a", ';')) == Strings({"a"}));
+  EXPECT(Tokens(StringSplit("a;b;c", ';')) == Strings({"a", "b", "c"}));
+
+  // Empty tokens are kept, except after a trailing delimiter.
+  EXPECT(Tokens(StringSplit(";a", ';')) == Strings({"", "a"}));
+  EXPECT(Tokens(StringSplit("a;", ';')) == Strings({"a"}));
+  EXPECT(Tokens(StringSplit("a;;b", ';')) == Strings({"a", "", "b"}));
+  EXPECT(Tokens(StringSplit(";", ';')) == Strings({""}));
+  EXPECT(Tokens(StringSplit(";;", ';')) == Strings({"", ""}));
+
+  // Tokens are views into the text.
+  std::string_view text = "ab;cd";
+  auto tokens = StringSplit(text, ';');
+  auto it = tokens.begin();
+  EXPECT(it->data() == text.data());
+  ++it;
+  EXPECT(it->data() == text.data() + 3 && it->size() == 2);
+  EXPECT(++it == tokens.end());
+  EXPECT(*tokens.begin()++ == "ab");
+}
+
+// The first enclosure character comes off the front and the last off the
+// back, each only if it is there.
+void TestEnclosure() {
+  EXPECT(Tokens(StringSplit("\"a b\";\"c\"", ';', "\"")) ==
+         Strings({"a b", "c"}));
+  EXPECT(Tokens(StringSplit("\"a;b\"", ';', "\"")) == Strings({"a", "b"}));
+  // One and two character tokens.
+  EXPECT(Tokens(StringSplit("\"", ';', "\"")) == Strings({""}));
+  EXPECT(Tokens(StringSplit("\"\"", ';', "\"")) == Strings({""}));
+  EXPECT(Tokens(StringSplit("\"x", ';', "\"")) == Strings({"x"}));
+  EXPECT(Tokens(StringSplit("x\"", ';', "\"")) == Strings({"x"}));
+  EXPECT(Tokens(StringSplit("x", ';', "\"")) == Strings({"x"}));
+  EXPECT(Tokens(StringSplit("\"\"\"", ';', "\"")) == Strings({"\""}));
+
+  // Different front and back characters.
+  EXPECT(Tokens(StringSplit("[a];[b;c];]", ';', "[]")) ==
+         Strings({"a", "b", "c", ""}));
+  EXPECT(Tokens(StringSplit("[", ';', "[]")) == Strings({""}));
+  EXPECT(Tokens(StringSplit("][", ';', "[]")) == Strings({"]["}));
+
+  EXPECT(Tokens(StringSplit(L"\"C:\\a b\" \"x\"", L' ', L"\"")) ==
+         std::vector<std::wstring>({L"C:\\a", L"b", L"x"}));
+}
+
+void TestFunctionKey() {
+  EXPECT(ParseFunctionKey(L"F1") == 1);
+  EXPECT(ParseFunctionKey(L"f12") == 12);
+  EXPECT(ParseFunctionKey(L"F24") == 24);
+  EXPECT(ParseFunctionKey(L"F0") == 0);
+  EXPECT(ParseFunctionKey(L"F25") == 0);
+  EXPECT(ParseFunctionKey(L"F99999999999") == 0);
+  EXPECT(ParseFunctionKey(L"F") == 0);
+  EXPECT(ParseFunctionKey(L"") == 0);
+  EXPECT(ParseFunctionKey(L"Fx") == 0);
+  EXPECT(ParseFunctionKey(L"G5") == 0);
+  EXPECT(ParseFunctionKey(L"F05") == 5);
+
+  // Only the digits inside the token count, like "F1+2" split at '+'.
+  std::wstring_view keys = L"F1+2";
+  EXPECT(ParseFunctionKey(keys.substr(0, 2)) == 1);
+  std::vector<int> numbers;
+  for (std::wstring_view key : StringSplit(L"ctrl+F2+F13+F30", L'+')) {
+    numbers.push_back(ParseFunctionKey(key));
+  }
+  EXPECT(numbers == std::vector<int>({0, 2, 13, 0}));
+}
+
+int main() {
+  TestSplit();
+  TestEnclosure();
+  TestFunctionKey();
+  return TestResult();
+}
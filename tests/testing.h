@@ -0,0 +1,28 @@
+#ifndef TESTS_TESTING_H_
+#define TESTS_TESTING_H_
+
+#include <stdio.h>
+
+// Checks for the unit tests, which need nothing but the standard library. A
+// failed check is printed and counted; main() returns TestResult().
+int test_failures = 0;
+
+#define EXPECT(condition)                                         \
+  do {                                                            \
+    if (!(condition)) {                                           \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, \
+              #condition);                                        \
+      ++test_failures;                                            \
+    }                                                             \
+  } while (0)
+
+int TestResult() {
+  if (test_failures) {
+    fprintf(stderr, "%d check(s) failed\n", test_failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
+
+#endif  // TESTS_TESTING_H_
@@ -0,0 +1,505 @@
+// Offline inspection and pre-patching of Chrome .pak files, built from the
+// same pakfile.h and pakrules.h code that patches resources.pak inside the
+// browser.
+//
+//   pakutil list FILE
+//   pakutil extract FILE ID OUT [--raw]
+//   pakutil verify FILE
+//   pakutil patch FILE OUT [--rules INI]... [--threads N] [--sidecar]
+//   pakutil bench FILE [--rules INI]... [--repeat N]
+//
+// resources.pak gets the built-in about page rule, --rules adds the
+// [pak_patch*] sections of chrome++.ini or chrome++.pakrules. A pak gets
+// every section whose file pattern matches it, as in the dll. With
+// --sidecar, OUT gets the trailer of resources.pak.patched, so a deployment
+// can ship the patched pak and the dll maps it directly. The trailer keys on
+// the write time of FILE, so run it on the deployed copy and pass the same
+// rule files in the same order as the dll reads them (chrome++.ini first).
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool verbose = false;
+
+// pakfile.h logs through DebugLog, which the dll takes from utils.h.
+void DebugLog(const wchar_t* format, ...) {
+  if (!verbose)
+    return;
+  wchar_t message[1024];
+  va_list args;
+  va_start(args, format);
+  vswprintf(message, sizeof(message) / sizeof(message[0]), format, args);
+  va_end(args);
+  fprintf(stderr, "%ls\n", message);
+}
+
+#include "pakfile.h"
+#include "pakrules.h"
+
+// A copy-on-write mapping, like the FILE_MAP_COPY view the dll patches:
+// writes stay private to the process. A second read-only view keeps showing
+// the file as it is on disk.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  bool Open(const char* path) {
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER size;
+    FILETIME write_time;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+        GetFileTime(file, nullptr, nullptr, &write_time)) {
+      HANDLE map =
+          CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+      if (map) {
+        data_ = (uint8_t*)MapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+        pristine_ =
+            (const uint8_t*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(map);
+      }
+      size_ = (size_t)size.QuadPart;
+      mtime_ =
+          (uint64_t)write_time.dwHighDateTime << 32 | write_time.dwLowDateTime;
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE, fd, 0);
+      if (view != MAP_FAILED)
+        data_ = (uint8_t*)view;
+      view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (view != MAP_FAILED)
+        pristine_ = (const uint8_t*)view;
+      size_ = (size_t)st.st_size;
+      // The same FILETIME the dll reads with GetFileTime.
+      mtime_ = ((uint64_t)st.st_mtim.tv_sec + 11644473600ull) * 10000000 +
+               (uint64_t)st.st_mtim.tv_nsec / 100;
+    }
+    close(fd);
+#endif
+    if (!data_)
+      size_ = 0;
+    return data_ != nullptr;
+  }
+
+  void Close() {
+#ifdef _WIN32
+    if (pristine_)
+      UnmapViewOfFile(pristine_);
+    if (data_)
+      UnmapViewOfFile(data_);
+#else
+    if (pristine_)
+      munmap((void*)pristine_, size_);
+    if (data_)
+      munmap(data_, size_);
+#endif
+    pristine_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  uint8_t* data() const { return data_; }
+  // May be null, the traversal then copies slots aside itself.
+  const uint8_t* pristine() const { return pristine_; }
+  size_t size() const { return size_; }
+  // The write time as a FILETIME.
+  uint64_t mtime() const { return mtime_; }
+
+ private:
+  uint8_t* data_ = nullptr;
+  const uint8_t* pristine_ = nullptr;
+  size_t size_ = 0;
+  uint64_t mtime_ = 0;
+};
+
+bool ReadWholeFile(const char* path, std::string& data) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+  char chunk[64 * 1024];
+  size_t read;
+  data.clear();
+  while ((read = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    data.append(chunk, read);
+  }
+  fclose(fp);
+  return true;
+}
+
+bool WriteWholeFile(const char* path,
+                    const void* data,
+                    size_t size,
+                    const void* trailer = nullptr,
+                    size_t trailer_size = 0) {
+  FILE* fp = fopen(path, "wb");
+  if (!fp)
+    return false;
+  bool written = fwrite(data, 1, size, fp) == size &&
+                 (!trailer || fwrite(trailer, 1, trailer_size, fp) ==
+                                  trailer_size);
+  return fclose(fp) == 0 && written;
+}
+
+// Add the [pak_patch*] sections of an INI file the same way LoadPakRules in
+// pakpatch.h adds them.
+bool LoadRulesFile(const char* path, PakRuleSet& rules) {
+  std::string raw;
+  if (!ReadWholeFile(path, raw))
+    return false;
+
+  IniFile ini;
+  ini.Parse(raw);
+  for (const std::string& name : rules.AddIniFile(ini)) {
+    fprintf(stderr, "invalid pak rule %s\n", name.c_str());
+  }
+  return true;
+}
+
+bool IsGzip(const uint8_t* data, uint32_t size) {
+  return size >= 3 && data[0] == 0x1F && data[1] == 0x8B && data[2] == 0x08;
+}
+
+// Inflate a whole gzip member and check its CRC32 and ISIZE.
+bool InflateGzip(const uint8_t* data,
+                 uint32_t size,
+                 std::vector<uint8_t>& output,
+                 std::string& error) {
+  size_t header_size = GetGzipHeaderSize(data, size);
+  uint32_t original_size = GetGzipOriginalSize(data, size);
+  if (header_size == 0 || original_size == 0) {
+    error = "bad gzip header or trailer";
+    return false;
+  }
+
+  output.resize(original_size);
+  size_t inflated = tinfl_decompress_mem_to_mem(
+      output.data(), output.size(), data + header_size, size - header_size, 0);
+  if (inflated != original_size) {
+    error = "inflated size does not match ISIZE";
+    return false;
+  }
+
+  uint32_t crc = 0;
+  memcpy(&crc, data + size - 8, sizeof(crc));
+  if ((uint32_t)mz_crc32(MZ_CRC32_INIT, output.data(), output.size()) != crc) {
+    error = "CRC32 mismatch";
+    return false;
+  }
+  return true;
+}
+
+bool OpenPak(const char* path, MappedFile& file, PakIndex& index) {
+  if (!file.Open(path)) {
+    fprintf(stderr, "cannot map %s\n", path);
+    return false;
+  }
+  index = PakIndex(file.data(), file.size());
+  if (!index.IsValid()) {
+    fprintf(stderr, "%s is not a valid pak file\n", path);
+    return false;
+  }
+  return true;
+}
+
+int List(const char* path) {
+  MappedFile file;
+  PakIndex index(nullptr, 0);
+  if (!OpenPak(path, file, index))
+    return 1;
+
+  printf("%8s %10s %10s %10s  %s\n", "id", "offset", "size", "inflated",
+         "type");
+  for (PAK_ENTRY* entry = index.begin(); entry < index.end(); ++entry) {
+    const uint8_t* data = index.GetData(entry);
+    uint32_t size = index.GetSize(entry);
+    if (IsGzip(data, size)) {
+      printf("%8u %10u %10u %10u  gzip\n", entry->resource_id,
+             entry->file_offset, size, GetGzipOriginalSize(data, size));
+    } else {
+      printf("%8u %10u %10u %10s  raw\n", entry->resource_id,
+             entry->file_offset, size, "-");
+    }
+  }
+
+  PAK_ENTRY* pak_entry;
+  PAK_ENTRY* end_entry;
+  PAK_ALIAS* alias_entry;
+  PAK_ALIAS* alias_end;
+  CheckHeader(file.data(), file.size(), pak_entry, end_entry, alias_entry,
+              alias_end);
+  for (PAK_ALIAS* alias = alias_entry; alias < alias_end; ++alias) {
+    printf("%8u %10s %10s %10s  alias of %u\n", alias->resource_id, "-", "-",
+           "-", pak_entry[alias->entry_index].resource_id);
+  }
+  printf("%zu resources, %zu aliases, %zu bytes\n", index.size(),
+         (size_t)(alias_end - alias_entry), file.size());
+  return 0;
+}
+
+int Extract(const char* path, const char* id_text, const char* out, bool raw) {
+  MappedFile file;
+  PakIndex index(nullptr, 0);
+  if (!OpenPak(path, file, index))
+    return 1;
+
+  unsigned long id = strtoul(id_text, nullptr, 10);
+  if (id > 0xFFFF || !index.FindById((uint16_t)id)) {
+    fprintf(stderr, "no resource %s\n", id_text);
+    return 1;
+  }
+  ByteSpan resource = index.GetResource((uint16_t)id);
+
+  std::vector<uint8_t> inflated;
+  const uint8_t* data = resource.data();
+  size_t size = resource.size();
+  if (!raw && IsGzip(data, (uint32_t)size)) {
+    std::string error;
+    if (!InflateGzip(data, (uint32_t)size, inflated, error)) {
+      fprintf(stderr, "resource %lu: %s\n", id, error.c_str());
+      return 1;
+    }
+    data = inflated.data();
+    size = inflated.size();
+  }
+
+  if (!WriteWholeFile(out, data, size)) {
+    fprintf(stderr, "cannot write %s\n", out);
+    return 1;
+  }
+  printf("%zu bytes written to %s\n", size, out);
+  return 0;
+}
+
+int Verify(const char* path) {
+  MappedFile file;
+  PakIndex index(nullptr, 0);
+  if (!OpenPak(path, file, index))
+    return 1;
+
+  // CheckHeader already rejected tables that point outside the file, what
+  // is left is the content of every gzip resource.
+  int gzip_count = 0;
+  int failures = 0;
+  std::vector<uint8_t> inflated;
+  for (PAK_ENTRY* entry = index.begin(); entry < index.end(); ++entry) {
+    const uint8_t* data = index.GetData(entry);
+    uint32_t size = index.GetSize(entry);
+    if (!IsGzip(data, size))
+      continue;
+    ++gzip_count;
+    std::string error;
+    if (!InflateGzip(data, size, inflated, error)) {
+      printf("resource %u: %s\n", entry->resource_id, error.c_str());
+      ++failures;
+    }
+  }
+
+  printf("%zu resources, %d gzip, %d failed\n", index.size(), gzip_count,
+         failures);
+  return failures ? 1 : 0;
+}
+
+// Every rule whose pattern matches |pak_path|, merged in the order they are
+// read, like the dll merges them.
+bool LoadRules(const std::vector<const char*>& rule_files,
+               const std::string& pak_path,
+               PakRewriter& rewriter) {
+  PakRuleSet rules;
+  rules.AddBuiltinRules();
+  for (const char* path : rule_files) {
+    if (!LoadRulesFile(path, rules)) {
+      fprintf(stderr, "cannot read %s\n", path);
+      return false;
+    }
+  }
+  rules.BuildRewriter(Utf8ToWide(pak_path), rewriter);
+  return true;
+}
+
+std::vector<uint16_t> PatchPak(const MappedFile& file,
+                               const PakRewriter& rewriter,
+                               unsigned threads) {
+  return TraversalGZIPResources(
+      file.data(), file.size(),
+      [&](uint16_t id) { return rewriter.Select(id); }, rewriter.triggers(),
+      [&](uint16_t id, uint8_t* data, uint32_t length, uint32_t& new_len,
+          MinifyMode& squeeze) {
+        return rewriter.Rewrite(id, data, length, new_len, squeeze);
+      },
+      threads, file.pristine());
+}
+
+int Patch(const char* path,
+          const char* out,
+          const std::vector<const char*>& rule_files,
+          unsigned threads,
+          bool sidecar) {
+  PakRewriter rewriter;
+  if (!LoadRules(rule_files, path, rewriter))
+    return 1;
+
+  MappedFile file;
+  PakIndex index(nullptr, 0);
+  if (!OpenPak(path, file, index))
+    return 1;
+
+  // Hash the tables before patching, the dll keys on the original pak.
+  PakCacheTrailer trailer = {};
+  trailer.key =
+      MakePakKey(file.data(), file.size(), file.mtime(), rewriter);
+  trailer.magic = kPakCacheMagic;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint16_t> patched =
+      PatchPak(file, rewriter, threads);
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  for (uint16_t id : patched) {
+    printf("patched resource %u\n", id);
+  }
+  printf("%zu resources patched in %.1f ms\n", patched.size(), ms);
+
+  if (!WriteWholeFile(out, file.data(), file.size(),
+                      sidecar ? &trailer : nullptr,
+                      sidecar ? sizeof(trailer) : 0)) {
+    fprintf(stderr, "cannot write %s\n", out);
+    return 1;
+  }
+  return 0;
+}
+
+// Time a full patch of a fresh copy-on-write view per run, page faults
+// included, for several thread counts. "allocs" counts the arena
+// allocations of the last run, which is 0 once the arena pool is warm.
+int Bench(const char* path,
+          const std::vector<const char*>& rule_files,
+          int repeat) {
+  PakRewriter rewriter;
+  if (!LoadRules(rule_files, path, rewriter))
+    return 1;
+
+  printf("%8s %10s %10s %10s %8s %8s\n", "threads", "min ms", "p50 ms",
+         "max ms", "patched", "allocs");
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    std::vector<double> times;
+    size_t patched = 0;
+    uint64_t allocations = 0;
+    for (int i = 0; i < repeat; ++i) {
+      MappedFile file;
+      PakIndex index(nullptr, 0);
+      if (!OpenPak(path, file, index))
+        return 1;
+      PakArenaStats before = GetPakArenaStats();
+      auto start = std::chrono::steady_clock::now();
+      patched = PatchPak(file, rewriter, threads).size();
+      times.push_back(std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+      allocations = GetPakArenaStats().allocations - before.allocations;
+    }
+    std::sort(times.begin(), times.end());
+    printf("%8u %10.1f %10.1f %10.1f %8zu %8llu\n", threads, times.front(),
+           times[times.size() / 2], times.back(), patched,
+           (unsigned long long)allocations);
+  }
+  return 0;
+}
+
+int Usage() {
+  fprintf(stderr,
+          "usage: pakutil list FILE\n"
+          "       pakutil extract FILE ID OUT [--raw]\n"
+          "       pakutil verify FILE\n"
+          "       pakutil patch FILE OUT [--rules INI]... [--threads N] "
+          "[--sidecar]\n"
+          "       pakutil bench FILE [--rules INI]... [--repeat N]\n"
+          "       add --verbose to see the patch log\n");
+  return 2;
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<const char*> args;
+  std::vector<const char*> rule_files;
+  unsigned threads = 0;
+  int repeat = 5;
+  bool raw = false;
+  bool sidecar = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--raw") {
+      raw = true;
+    } else if (arg == "--sidecar") {
+      sidecar = true;
+    } else if (arg == "--verbose") {
+      verbose = true;
+    } else if (arg == "--rules" || arg == "--threads" || arg == "--repeat") {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "missing value for %s\n", arg.c_str());
+        return 2;
+      }
+      const char* value = argv[++i];
+      if (arg == "--rules") {
+        rule_files.push_back(value);
+      } else if (arg == "--threads") {
+        threads = (unsigned)strtoul(value, nullptr, 10);
+      } else {
+        repeat = (std::max)(1, atoi(value));
+      }
+    } else if (arg.compare(0, 2, "--") == 0) {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return 2;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+
+  if (args.size() < 2)
+    return Usage();
+  std::string command = args[0];
+  if (command == "list" && args.size() == 2)
+    return List(args[1]);
+  if (command == "extract" && args.size() == 4)
+    return Extract(args[1], args[2], args[3], raw);
+  if (command == "verify" && args.size() == 2)
+    return Verify(args[1]);
+  if (command == "patch" && args.size() == 3)
+    return Patch(args[1], args[2], rule_files, threads, sidecar);
+  if (command == "bench" && args.size() == 2)
+    return Bench(args[1], rule_files, repeat);
+  return Usage();
+}
@@ -0,0 +1,183 @@
+// Benchmark for ReplaceAll in stringreplace.h against chained
+// ReplaceStringInPlace calls, the way utils.h used to replace strings.
+//
+//   replacebench [--repeat N] [FILE]...
+//
+// Each FILE is a page to run the replacements over, e.g. the settings HTML
+// extracted with `pakutil extract resources.pak ID settings.html`. Without
+// one a synthetic page is used. Every case is run on std::string and on
+// std::wstring, and the outputs of all implementations are checked to be
+// the same.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "stringreplace.h"
+
+// The replacement loop utils.h used, one call per search string.
+template <typename Char>
+bool ReplaceStringInPlace(std::basic_string<Char>& subject,
+                          const std::basic_string<Char>& search,
+                          const std::basic_string<Char>& replace) {
+  bool find = false;
+  size_t pos = 0;
+  while ((pos = subject.find(search, pos)) != std::basic_string<Char>::npos) {
+    subject.replace(pos, search.length(), replace);
+    pos += replace.length();
+    find = true;
+  }
+  return find;
+}
+
+struct Case {
+  const char* name;
+  std::vector<std::pair<std::string, std::string>> pairs;
+};
+
+// None of the replacements contains a later search string, so chaining
+// gives the same result as a single pass.
+const Case kCases[] = {
+    {"about page",
+     {{R"(hidden="[[!showUpdateStatus_]]")", R"(hidden="true")"},
+      {R"(hidden="[[!shouldShowIcons_(showUpdateStatus_)]]")",
+       R"(hidden="true")"},
+      {R"({aboutBrowserVersion}</div>)",
+       R"({aboutBrowserVersion}</div><div class="secondary">Chrome++</div>)"}}},
+    {"many matches",
+     {{"<div", "<section"}, {"class=\"", "c=\""}, {"hidden", "data-hidden"}}},
+};
+
+bool ReadFile(const char* path, std::string& data) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data.resize(size > 0 ? size : 0);
+  bool ok = fread(&data[0], 1, data.size(), fp) == data.size();
+  fclose(fp);
+  return ok;
+}
+
+std::string SyntheticPage() {
+  std::string page;
+  for (int i = 0; i < 2000; ++i) {
+    page += "<div class=\"row\" hidden=\"[[!showUpdateStatus_]]\">\n";
+    page += "  <span class=\"label\">item " + std::to_string(i) + "</span>\n";
+    page += "</div>\n";
+  }
+  page += "<div>{aboutBrowserVersion}</div></settings-about-page>\n";
+  return page;
+}
+
+// ASCII only, which is all the cases use.
+std::wstring Widen(const std::string& text) {
+  return std::wstring(text.begin(), text.end());
+}
+
+double MedianMicroseconds(int repeat, const std::function<void()>& run) {
+  std::vector<double> times;
+  for (int i = 0; i < repeat; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    times.push_back(std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+template <typename Char>
+bool RunCase(const char* page_name,
+             const Case& test,
+             const std::basic_string<Char>& page,
+             const std::vector<std::pair<std::basic_string<Char>,
+                                         std::basic_string<Char>>>& strings,
+             const char* width,
+             int repeat) {
+  std::vector<ReplacePair<Char>> pairs;
+  for (const auto& pair : strings) {
+    pairs.emplace_back(pair.first, pair.second);
+  }
+
+  std::basic_string<Char> chained;
+  double chained_us = MedianMicroseconds(repeat, [&]() {
+    chained = page;
+    for (const auto& pair : strings) {
+      ReplaceStringInPlace(chained, pair.first, pair.second);
+    }
+  });
+
+  std::basic_string<Char> single;
+  double single_us = MedianMicroseconds(repeat, [&]() {
+    single = page;
+    ReplaceAll(single, pairs.data(), pairs.size());
+  });
+
+  std::vector<Char> buffer(page.size() * 2 + 1024);
+  size_t buffer_size = 0;
+  double buffer_us = MedianMicroseconds(repeat, [&]() {
+    buffer_size = ReplaceAll(std::basic_string_view<Char>(page), pairs.data(),
+                             pairs.size(), buffer.data(), buffer.size());
+  });
+
+  size_t matches = 0;
+  ReplaceAllSize(std::basic_string_view<Char>(page), pairs.data(),
+                 pairs.size(), &matches);
+  bool same = single == chained && buffer_size == chained.size() &&
+              std::equal(chained.begin(), chained.end(), buffer.begin());
+
+  printf("%-16s %-14s %-8s %8zu %10.1f %10.1f %10.1f %8.1fx %s\n", page_name,
+         test.name, width, matches, chained_us, single_us, buffer_us,
+         chained_us / (std::max)(single_us, 0.001), same ? "" : "MISMATCH");
+  return same;
+}
+
+int main(int argc, char* argv[]) {
+  int repeat = 20;
+  std::vector<std::pair<std::string, std::string>> pages;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = (std::max)(atoi(argv[++i]), 1);
+      continue;
+    }
+    std::string data;
+    if (!ReadFile(argv[i], data)) {
+      fprintf(stderr, "cannot read %s\n", argv[i]);
+      return 1;
+    }
+    const char* name = strrchr(argv[i], '/');
+    pages.emplace_back(name ? name + 1 : argv[i], data);
+  }
+  if (pages.empty())
+    pages.emplace_back("synthetic", SyntheticPage());
+
+  printf("%-16s %-14s %-8s %8s %10s %10s %10s %9s\n", "page", "case", "width",
+         "matches", "chained us", "single us", "buffer us", "speedup");
+  bool ok = true;
+  for (const auto& page : pages) {
+    for (const Case& test : kCases) {
+      ok &= RunCase<char>(page.first.c_str(), test, page.second, test.pairs,
+                          "string", repeat);
+
+      std::vector<std::pair<std::wstring, std::wstring>> wide;
+      for (const auto& pair : test.pairs) {
+        wide.emplace_back(Widen(pair.first), Widen(pair.second));
+      }
+      ok &= RunCase<wchar_t>(page.first.c_str(), test, Widen(page.second),
+                             wide, "wstring", repeat);
+    }
+  }
+  return ok ? 0 : 1;
+}
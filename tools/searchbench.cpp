@@ -0,0 +1,428 @@
+// Benchmark for the substring search kernels in fastsearch.h and friends.
+//
+//   searchbench [--size MB] [--repeat N] [--filter TEXT]
+//               [--corpus FILE]... [--pe FILE]... [--needle TEXT]
+//               [--save FILE] [--baseline FILE] [--threshold PERCENT]
+//
+// Every kernel runs over synthetic best and worst cases, over each --corpus
+// file (e.g. resources extracted with `pakutil extract`) and over the .text
+// and .rdata sections of each --pe image. Throughput is computed from the
+// median call. With --baseline the run fails when a result is slower than
+// the saved one by more than --threshold percent (10 by default).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fastsearch.h"
+#include "multisearch.h"
+#include "parallelsearch.h"
+#include "peimage.h"
+
+typedef std::vector<uint8_t> Bytes;
+typedef std::function<uintptr_t(const uint8_t* s, int n)> BoundSearch;
+
+struct Case {
+  std::string name;
+  Bytes data;
+  std::vector<Bytes> needles;
+};
+
+struct Kernel {
+  std::string name;
+  // Prepare the search for the needles of a case, or return an empty
+  // function when the kernel does not apply.
+  std::function<BoundSearch(const std::vector<Bytes>& needles)> bind;
+};
+
+struct Result {
+  double gbps;
+  double p50_us;
+  double p90_us;
+  double p99_us;
+};
+
+bool ReadFile(const char* path, Bytes& data) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data.resize(size > 0 ? size : 0);
+  bool ok = fread(data.data(), 1, data.size(), fp) == data.size();
+  fclose(fp);
+  return ok;
+}
+
+Bytes ToBytes(const std::string& text) {
+  return Bytes(text.begin(), text.end());
+}
+
+// utils.h's memmem as it was before the SIMD kernels: ForceSearch for one
+// byte, otherwise Sunday with a size_t skip table built on every call. utils.h
+// needs windows.h, so the code is copied here. The original also read the
+// byte after the buffer once the last window failed, this copy stops there.
+const uint8_t* BaselineMemmem(const uint8_t* s,
+                              int n,
+                              const uint8_t* p,
+                              int m) {
+  if (!s || !p || n < m)
+    return nullptr;
+  if (m == 0)
+    return s;
+  if (m == 1) {
+    for (int i = 0; i < n; ++i) {
+      if (s[i] == *p)
+        return s + i;
+    }
+    return nullptr;
+  }
+
+  size_t skip[256];
+  for (int i = 0; i < 256; ++i) {
+    skip[i] = m + 1;
+  }
+  for (int i = 0; i < m; ++i) {
+    skip[p[i]] = m - i;
+  }
+
+  int i = 0;
+  while (i <= n - m) {
+    int j = 0;
+    while (s[i + j] == p[j]) {
+      ++j;
+      if (j >= m)
+        return s + i;
+    }
+    if (i + m >= n)
+      break;
+    i += (int)skip[s[i + m]];
+  }
+  return nullptr;
+}
+
+// Wrap a kernel with the FastSearch signature that takes a single needle.
+Kernel SingleKernel(const char* name, SearchKernel search, int only_m = 0) {
+  return {name, [=](const std::vector<Bytes>& needles) -> BoundSearch {
+            if (needles.size() != 1 ||
+                (only_m && (int)needles[0].size() != only_m))
+              return nullptr;
+            Bytes needle = needles[0];
+            return [=](const uint8_t* s, int n) {
+              if (n < (int)needle.size())
+                return (uintptr_t)0;
+              return (uintptr_t)search(s, n, needle.data(),
+                                       (int)needle.size());
+            };
+          }};
+}
+
+std::vector<Kernel> GetKernels() {
+  std::vector<Kernel> kernels;
+  kernels.push_back(SingleKernel("ForceSearch",
+                                 [](const uint8_t* s, int n, const uint8_t* p,
+                                    int) { return ForceSearch(s, n, p); },
+                                 1));
+  kernels.push_back(SingleKernel("SundaySearch", SundaySearch));
+  kernels.push_back(SingleKernel("TwoWaySearch", TwoWaySearch));
+#ifdef FASTSEARCH_X86
+  kernels.push_back(SingleKernel("Sse2Search", Sse2Search));
+  if (IsAvx2Supported())
+    kernels.push_back(SingleKernel("Avx2Search", Avx2Search));
+#endif
+  kernels.push_back(SingleKernel("FastSearch", FastSearch));
+  kernels.push_back(SingleKernel("memmem (baseline)", BaselineMemmem));
+
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    kernels.push_back(
+        {"ParallelSearch/" + std::to_string(threads),
+         [threads](const std::vector<Bytes>& needles) -> BoundSearch {
+           if (needles.size() != 1)
+             return nullptr;
+           Bytes needle = needles[0];
+           return [=](const uint8_t* s, int n) {
+             return (uintptr_t)ParallelSearch(s, n, needle.data(),
+                                              (int)needle.size(), threads);
+           };
+         }});
+  }
+
+  kernels.push_back(
+      {"Searcher", [](const std::vector<Bytes>& needles) -> BoundSearch {
+         if (needles.size() != 1)
+           return nullptr;
+         auto needle = std::make_shared<Bytes>(needles[0]);
+         auto searcher =
+             std::make_shared<Searcher>(needle->data(), (int)needle->size());
+         return [=](const uint8_t* s, int n) {
+           uintptr_t hits = 0;
+           for (const uint8_t* match : searcher->FindAll(s, n)) {
+             hits += (uintptr_t)match;
+           }
+           return hits;
+         };
+       }});
+
+  // Several needles: N sequential FastSearch calls against one pass.
+  kernels.push_back(
+      {"FastSearch xN", [](const std::vector<Bytes>& needles) -> BoundSearch {
+         if (needles.size() < 2)
+           return nullptr;
+         return [=](const uint8_t* s, int n) {
+           uintptr_t hits = 0;
+           for (const Bytes& needle : needles) {
+             hits += (uintptr_t)FastSearch(s, n, needle.data(),
+                                           (int)needle.size());
+           }
+           return hits;
+         };
+       }});
+  kernels.push_back(
+      {"MultiSearcher", [](const std::vector<Bytes>& needles) -> BoundSearch {
+         if (needles.size() < 2)
+           return nullptr;
+         auto searcher = std::make_shared<MultiSearcher>();
+         for (const Bytes& needle : needles) {
+           searcher->Add(needle.data(), (int)needle.size());
+         }
+         return [=](const uint8_t* s, int n) {
+           uintptr_t hits = 0;
+           searcher->Scan(s, n, [&](int id, const uint8_t* match) {
+             hits += (uintptr_t)match + id;
+           });
+           return hits;
+         };
+       }});
+  return kernels;
+}
+
+std::vector<Case> GetSyntheticCases(size_t size) {
+  std::mt19937 rng(20240101);
+  std::vector<Case> cases;
+
+  Bytes random(size);
+  for (auto& c : random) {
+    c = (uint8_t)rng();
+  }
+
+  {
+    Bytes needle(16);
+    for (auto& c : needle) {
+      c = (uint8_t)rng();
+    }
+    cases.push_back({"random", random, {needle}});
+  }
+
+  {
+    Bytes data(random);
+    for (auto& c : data) {
+      c = c == 0xFF ? 0xFE : c;
+    }
+    cases.push_back({"random/1-byte", data, {{0xFF}}});
+  }
+
+  {
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyz      <>/=\"-\n";
+    Bytes data(size);
+    for (auto& c : data) {
+      c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    cases.push_back(
+        {"html", data, {ToBytes("</settings-about-page>")}});
+  }
+
+  {
+    Bytes needle(512, 0);
+    needle[256] = 1;
+    cases.push_back({"zeros/worst", Bytes(size, 0), {needle}});
+  }
+
+  {
+    Bytes data(size);
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = "ab"[i & 1];
+    }
+    std::string needle;
+    for (int i = 0; i < 32; ++i) {
+      needle += "ab";
+    }
+    cases.push_back({"periodic/worst", data, {ToBytes(needle + "c")}});
+  }
+
+  {
+    std::vector<Bytes> needles(8, Bytes(12));
+    for (auto& needle : needles) {
+      for (auto& c : needle) {
+        c = (uint8_t)rng();
+      }
+    }
+    cases.push_back({"random/multi", random, needles});
+  }
+
+  return cases;
+}
+
+volatile uintptr_t sink;
+
+Result Run(const BoundSearch& search, const Bytes& data, int repeat) {
+  std::vector<double> samples;
+  for (int i = 0; i < repeat; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    sink = search(data.data(), (int)data.size());
+    auto end = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+
+  auto percentile = [&](int p) {
+    return samples[std::min(samples.size() - 1, samples.size() * p / 100)];
+  };
+  Result result;
+  result.p50_us = percentile(50);
+  result.p90_us = percentile(90);
+  result.p99_us = percentile(99);
+  result.gbps = result.p50_us > 0 ? data.size() / result.p50_us / 1e3 : 0;
+  return result;
+}
+
+std::map<std::string, double> LoadBaseline(const char* path) {
+  std::map<std::string, double> baseline;
+  FILE* fp = fopen(path, "r");
+  if (!fp)
+    return baseline;
+  char line[1024];
+  while (fgets(line, sizeof(line), fp)) {
+    char* tab = strrchr(line, '\t');
+    if (!tab)
+      continue;
+    *tab = '\0';
+    baseline[line] = atof(tab + 1);
+  }
+  fclose(fp);
+  return baseline;
+}
+
+int main(int argc, char* argv[]) {
+  size_t size = 64;
+  int repeat = 15;
+  double threshold = 10;
+  std::string filter;
+  std::string needle = "</settings-about-page>";
+  const char* save = nullptr;
+  const char* baseline_path = nullptr;
+  std::vector<const char*> corpus;
+  std::vector<const char*> images;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      fprintf(stderr, "missing value for %s\n", arg.c_str());
+      return 2;
+    }
+    if (arg == "--size") {
+      size = strtoul(value, nullptr, 10);
+    } else if (arg == "--repeat") {
+      repeat = std::max(1, atoi(value));
+    } else if (arg == "--threshold") {
+      threshold = atof(value);
+    } else if (arg == "--filter") {
+      filter = value;
+    } else if (arg == "--needle") {
+      needle = value;
+    } else if (arg == "--corpus") {
+      corpus.push_back(value);
+    } else if (arg == "--pe") {
+      images.push_back(value);
+    } else if (arg == "--save") {
+      save = value;
+    } else if (arg == "--baseline") {
+      baseline_path = value;
+    } else {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return 2;
+    }
+    ++i;
+  }
+
+  std::vector<Case> cases = GetSyntheticCases(size * 1024 * 1024);
+  for (const char* path : corpus) {
+    Case c{path, {}, {ToBytes(needle)}};
+    if (!ReadFile(path, c.data)) {
+      fprintf(stderr, "cannot read %s\n", path);
+      return 2;
+    }
+    cases.push_back(c);
+  }
+  for (const char* path : images) {
+    Bytes image;
+    if (!ReadFile(path, image)) {
+      fprintf(stderr, "cannot read %s\n", path);
+      return 2;
+    }
+    for (const char* name : {".text", ".rdata"}) {
+      PeSection section;
+      if (FindPeSection(image.data(), image.size(), name, section)) {
+        cases.push_back({std::string(path) + ":" + name,
+                         Bytes(section.data, section.data + section.size),
+                         {ToBytes(needle)}});
+      }
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (baseline_path)
+    baseline = LoadBaseline(baseline_path);
+  FILE* out = save ? fopen(save, "w") : nullptr;
+
+  int regressions = 0;
+  printf("%-28s %-18s %9s %12s %12s %12s\n", "case", "kernel", "GB/s",
+         "p50 us", "p90 us", "p99 us");
+  std::vector<Kernel> kernels = GetKernels();
+  for (const Case& c : cases) {
+    for (const Kernel& kernel : kernels) {
+      std::string key = c.name + "\t" + kernel.name;
+      if (!filter.empty() && (c.name + " " + kernel.name).find(filter) ==
+                                 std::string::npos)
+        continue;
+      BoundSearch search = kernel.bind(c.needles);
+      if (!search)
+        continue;
+
+      Result result = Run(search, c.data, repeat);
+      const char* mark = "";
+      auto it = baseline.find(key);
+      if (it != baseline.end() &&
+          result.gbps < it->second * (1 - threshold / 100)) {
+        mark = "  REGRESSION";
+        ++regressions;
+      }
+      printf("%-28s %-18s %9.2f %12.1f %12.1f %12.1f%s\n", c.name.c_str(),
+             kernel.name.c_str(), result.gbps, result.p50_us, result.p90_us,
+             result.p99_us, mark);
+      if (out)
+        fprintf(out, "%s\t%.4f\n", key.c_str(), result.gbps);
+    }
+  }
+
+  if (out)
+    fclose(out);
+  if (regressions) {
+    fprintf(stderr, "%d result(s) regressed by more than %.0f%%\n",
+            regressions, threshold);
+    return 1;
+  }
+  return 0;
+}
@@ -4,20 +4,24 @@ add_rules("mode.debug", "mode.release")
 
 set_warnings("more")
 
-add_defines("WIN32", "_WIN32")
-add_defines("UNICODE", "_UNICODE", "_CRT_SECURE_NO_WARNINGS", "_CRT_NONSTDC_NO_DEPRECATE")
+-- The dll only builds on Windows. The tools below also build on Linux
+-- and must not pick up these settings.
+if is_plat("windows") then
+    add_defines("WIN32", "_WIN32")
+    add_defines("UNICODE", "_UNICODE", "_CRT_SECURE_NO_WARNINGS", "_CRT_NONSTDC_NO_DEPRECATE")
 
-if is_mode("release") then
-    add_defines("NDEBUG")
-    add_cxflags("/O2", "/Os", "/Gy", "/MT", "/EHsc", "/fp:precise")
-    add_ldflags("/DYNAMICBASE", "/LTCG")
-end
+    if is_mode("release") then
+        add_defines("NDEBUG")
+        add_cxflags("/O2", "/Os", "/Gy", "/MT", "/EHsc", "/fp:precise")
+        add_ldflags("/DYNAMICBASE", "/LTCG")
+    end
 
-add_cxflags("/utf-8")
+    add_cxflags("/utf-8")
 
--- add_links("gdiplus", "kernel32", "user32", "gdi32", "winspool", "comdlg32")
--- add_links("advapi32", "shell32", "ole32", "oleaut32", "uuid", "odbc32", "odbccp32")
-add_links("kernel32", "user32", "shell32", "oleaut32", "propsys", "shlwapi", "crypt32", "advapi32", "netapi32")
+    -- add_links("gdiplus", "kernel32", "user32", "gdi32", "winspool", "comdlg32")
+    -- add_links("advapi32", "shell32", "ole32", "oleaut32", "uuid", "odbc32", "odbccp32")
+    add_links("kernel32", "user32", "shell32", "oleaut32", "propsys", "shlwapi", "crypt32", "advapi32", "netapi32")
+end
 
 target("detours")
     set_kind("static")
@@ -37,4 +41,56 @@ target("chrome_plus")
     after_build(function (target)
         os.rm("$(buildir)/release/version.exp")
         os.rm("$(buildir)/release/version.lib")
-    end)
\ No newline at end of file
+    end)
+
+-- Standalone tools, they only use the portable headers and also build on
+-- Linux. Not built by default: xmake build searchbench
+target("searchbench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("c++17")
+    add_files("tools/searchbench.cpp")
+    add_includedirs("src")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- Offline pak inspection and pre-patching: xmake build pakutil
+target("pakutil")
+    set_kind("binary")
+    set_default(false)
+    set_languages("c++17")
+    add_files("tools/pakutil.cpp")
+    add_includedirs("src")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- String replacement benchmark: xmake build replacebench
+target("replacebench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("c++17")
+    add_files("tools/replacebench.cpp")
+    add_includedirs("src")
+
+-- Unit tests for the portable headers, they also build on Linux:
+-- xmake build -g test, then run each target. pakfile_test needs mini_gzip
+-- next to src, like the dll.
+for _, name in ipairs({"fastsearch_test", "signature_test", "parallelsearch_test",
+                       "pakfile_test", "inifile_test", "multisearch_test",
+                       "streamsearch_test", "pakrules_test",
+                       "stringreplace_test", "htmlminify_test",
+                       "stringsplit_test"}) do
+    target(name)
+        set_kind("binary")
+        set_default(false)
+        set_group("test")
+        set_languages("c++17")
+        add_files("tests/" .. name .. ".cpp")
+        add_includedirs("src")
+        if is_plat("linux") then
+            add_syslinks("pthread")
+        end
+    target_end()
+end
\ No newline at end of file